@@ -0,0 +1,217 @@
+#include <iostream>
+#include "glad/glad.h"
+
+#include "HeadlessContext.h"
+#include "GpuBvhBuilder.h"
+#include "GpuBvhRefitter.h"
+#include "DynamicBvh.h"
+#include "Bvh.h"
+#include "Scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+/*
+ * Build time of the GPU LBVH against primitive count, next to the host SAH build
+ * for reference. Every GPU tree is read back once and checked with Bvh::Validate.
+ * A second table animates the same clouds, every sphere drifting along its own
+ * velocity, and compares refitting on the CPU and on the GPU against rebuilding,
+ * with the rebuilds DynamicBvh's quality monitor triggered along the way.
+ * Usage: TracerLbvhBench [repeats] [count...]
+ */
+
+namespace {
+
+	const int REFIT_FRAMES = 32;
+	// GPU cost readbacks stall, only measure every few frames.
+	const int COST_INTERVAL = 4;
+
+	double Ms(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void Upload(GLuint buffer, const void* data, GLsizeiptr bytes) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, data, GL_DYNAMIC_DRAW);
+	}
+
+	// Where a sphere has drifted to after `frame` steps.
+	Shape Drift(const Shape& s, const glm::vec3& velocity, int frame) {
+		Shape moved = s;
+		for (int k = 0; k < 3; k++) {
+			moved.A[k] += velocity[k] * frame;
+		}
+		return moved;
+	}
+
+	bool BenchRefit(const std::vector<int>& counts) {
+		std::cout << std::endl << std::setw(10) << "prims" << std::setw(12) << "cpu refit" << std::setw(12) << "gpu refit"
+			<< std::setw(12) << "rebuild ms" << std::setw(12) << "cpu ratio" << std::setw(12) << "gpu ratio"
+			<< std::setw(10) << "rebuilds" << std::setw(8) << "valid" << std::endl;
+
+		GpuBvhRefitter refitter;
+		bool ok = true;
+		for (int count : counts) {
+			if (count <= 0) continue;
+			std::vector<Shape> cloud = SphereCloud(count);
+			std::default_random_engine rng(7);
+			std::uniform_real_distribution<float> dir(-1.0f, 1.0f);
+			std::vector<glm::vec3> velocity(cloud.size());
+			for (glm::vec3& v : velocity) {
+				v = glm::vec3(dir(rng), dir(rng), dir(rng)) * 0.02f;
+			}
+
+			DynamicBvh cpu(cloud);
+			DynamicBvh gpu(cloud);
+
+			GLuint buffers[2];
+			glGenBuffers(2, buffers);
+			Upload(buffers[0], gpu.Shapes().data(), gpu.Shapes().size() * sizeof(Shape));
+			Upload(buffers[1], gpu.Nodes().data(), gpu.Nodes().size() * sizeof(BvhNode));
+			refitter.SetTopology(gpu.Nodes());
+
+			double cpu_ms = 0.0, gpu_ms = 0.0;
+			for (int frame = 1; frame <= REFIT_FRAMES; frame++) {
+				auto start = std::chrono::steady_clock::now();
+				for (uint32_t i = 0; i < cloud.size(); i++) {
+					cpu.Update(i, Drift(cloud[i], velocity[i], frame));
+				}
+				cpu.Commit();
+				cpu_ms += Ms(start);
+
+				start = std::chrono::steady_clock::now();
+				for (uint32_t i = 0; i < cloud.size(); i++) {
+					gpu.Update(i, Drift(cloud[i], velocity[i], frame));
+				}
+				// Every shape moved, one upload beats one per Dirty() entry.
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpu.Shapes().size() * sizeof(Shape), gpu.Shapes().data());
+				refitter.Refit(buffers[0], buffers[1]);
+				float measured = (frame % COST_INTERVAL == 0) ? refitter.Cost(buffers[1]) : -1.0f;
+				if (gpu.Commit(measured) == DynamicBvh::Result::REBUILT) {
+					Upload(buffers[0], gpu.Shapes().data(), gpu.Shapes().size() * sizeof(Shape));
+					Upload(buffers[1], gpu.Nodes().data(), gpu.Nodes().size() * sizeof(BvhNode));
+					refitter.SetTopology(gpu.Nodes());
+				}
+				glFinish();
+				gpu_ms += Ms(start);
+			}
+
+			std::vector<BvhNode> gpu_nodes(gpu.Nodes().size());
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpu_nodes.size() * sizeof(BvhNode), gpu_nodes.data());
+			bool valid = Bvh::Validate(cpu.Nodes(), cpu.Shapes()) && Bvh::Validate(gpu_nodes, gpu.Shapes());
+			ok = ok && valid;
+
+			std::vector<Shape> final_shapes = cpu.Shapes();
+			auto start = std::chrono::steady_clock::now();
+			Bvh::Build(final_shapes);
+			double rebuild_ms = Ms(start);
+
+			std::cout << std::setw(10) << cloud.size() << std::setw(12) << cpu_ms / REFIT_FRAMES << std::setw(12) << gpu_ms / REFIT_FRAMES
+				<< std::setw(12) << rebuild_ms << std::setw(12) << cpu.Cost() / cpu.BuildCost() << std::setw(12) << Bvh::Cost(gpu_nodes) / gpu.BuildCost()
+				<< std::setw(5) << cpu.Rebuilds() << '/' << std::setw(4) << std::left << gpu.Rebuilds() << std::right
+				<< std::setw(8) << (valid ? "yes" : "NO") << std::endl;
+
+			glDeleteBuffers(2, buffers);
+		}
+		return ok;
+	}
+}
+
+int main(int argc, char** argv) {
+
+	int repeats = 10;
+	std::vector<int> counts = { 1000, 10000, 100000, 1000000 };
+	if (argc > 1) {
+		repeats = std::max(1, std::atoi(argv[1]));
+	}
+	if (argc > 2) {
+		counts.clear();
+		for (int i = 2; i < argc; i++) {
+			counts.push_back(std::atoi(argv[i]));
+		}
+	}
+
+	HeadlessContext context;
+	if (!context.Init(4, 5)) {
+		return 1;
+	}
+	std::cout << glGetString(GL_VENDOR) << ' ' << glGetString(GL_RENDERER) << std::endl;
+
+	GpuBvhBuilder builder;
+
+	GLuint query;
+	glGenQueries(1, &query);
+
+	std::cout << std::setw(10) << "prims" << std::setw(12) << "gpu avg ms" << std::setw(12) << "wall min ms" << std::setw(12) << "wall avg ms"
+		<< std::setw(12) << "sah ms" << std::setw(12) << "lbvh cost" << std::setw(12) << "sah cost" << std::setw(8) << "valid" << std::endl;
+
+	int status = 0;
+	for (int count : counts) {
+		if (count <= 0) continue;
+		std::vector<Shape> obj = SphereCloud(count);
+		const GLuint n = (GLuint)obj.size();
+
+		GLuint buffers[3];
+		glGenBuffers(3, buffers);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(Shape), obj.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(Shape), nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[2]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (2 * n - 1) * sizeof(BvhNode), nullptr, GL_DYNAMIC_COPY);
+
+		// Warm up, first dispatches include driver side compilation and allocation.
+		builder.Build(buffers[0], buffers[1], buffers[2], n);
+		glFinish();
+
+		// Timer queries measure the device, the glFinish bracket what a frame actually waits for.
+		// Software rasterizers may not implement the former meaningfully.
+		double gpu_sum = 0.0, wall_min = 1e30, wall_sum = 0.0;
+		for (int r = 0; r < repeats; r++) {
+			auto start = std::chrono::steady_clock::now();
+			glBeginQuery(GL_TIME_ELAPSED, query);
+			builder.Build(buffers[0], buffers[1], buffers[2], n);
+			glEndQuery(GL_TIME_ELAPSED);
+			glFinish();
+			double wall = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+			gpu_sum += ns * 1e-6;
+			wall_min = std::min(wall_min, wall);
+			wall_sum += wall;
+		}
+
+		std::vector<BvhNode> gpu_nodes(2 * n - 1);
+		std::vector<Shape> gpu_sorted(n);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * sizeof(Shape), gpu_sorted.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[2]);
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpu_nodes.size() * sizeof(BvhNode), gpu_nodes.data());
+		bool valid = Bvh::Validate(gpu_nodes, gpu_sorted);
+		if (!valid) {
+			status = 1;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<BvhNode> sah_nodes = Bvh::Build(obj);
+		double sah_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << std::setw(10) << n << std::setw(12) << gpu_sum / repeats << std::setw(12) << wall_min << std::setw(12) << wall_sum / repeats
+			<< std::setw(12) << sah_ms << std::setw(12) << Bvh::Cost(gpu_nodes) << std::setw(12) << Bvh::Cost(sah_nodes)
+			<< std::setw(8) << (valid ? "yes" : "NO") << std::endl;
+
+		glDeleteBuffers(3, buffers);
+	}
+
+	glDeleteQueries(1, &query);
+
+	if (!BenchRefit(counts)) {
+		status = 1;
+	}
+	return status;
+}
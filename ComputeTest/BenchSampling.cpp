@@ -0,0 +1,186 @@
+#include <iostream>
+#include "glad/glad.h"
+
+#include "HeadlessContext.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "Lights.h"
+#include "Bvh.h"
+#include "Tile.h"
+#include "FrameUniforms.h"
+#include "RayVariant.h"
+#include "RayStats.h"
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <vector>
+
+/*
+ * The closed form sphere, disk and hemisphere mappings in random.glsl against the
+ * rejection loops they replaced, built with REJECTION_SAMPLING. The scenes cover
+ * every caller: Lambert everywhere, metal in the field, isotropic scattering in
+ * the fog, and a thin lens on all of them. Speed is timed on plain programs; rays
+ * and dimensions, the rng() calls per path, are counted over one more sample by
+ * programs built with RayStats. Both trace the same light, so the means should agree.
+ * Usage: TracerSamplingBench [width height] [samples]
+ */
+
+namespace {
+
+	struct Scene {
+		const char* name;
+		std::function<std::vector<Shape>()> build;
+		glm::vec3 eye;
+		glm::vec3 target;
+	};
+
+	struct Result {
+		double seconds;
+		double mean;
+		RayStats::Counts counts;
+	};
+
+	void Reset(GLuint tex_output, int width, int height) {
+		std::vector<float> black(width * height * 4, 0.0f);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, black.data());
+		glFinish();
+	}
+
+	double Mean(GLuint tex_output, int width, int height) {
+		std::vector<float> image(width * height * 4);
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, image.data());
+		double sum = 0.0;
+		for (size_t i = 0; i < image.size(); i += 4) {
+			sum += image[i] + image[i + 1] + image[i + 2];
+		}
+		return sum / (3.0 * width * height);
+	}
+
+	double Ratio(uint64_t n, uint64_t d) {
+		return (d > 0) ? (double)n / d : 0.0;
+	}
+}
+
+int main(int argc, char** argv) {
+
+	int width = 320;
+	int height = 180;
+	int samples = 4;
+	if (argc > 2) {
+		width = std::atoi(argv[1]);
+		height = std::atoi(argv[2]);
+	}
+	if (argc > 3) {
+		samples = std::atoi(argv[3]);
+	}
+	if (width <= 0 || height <= 0 || samples <= 0) {
+		std::cerr << "Usage: TracerSamplingBench [width height] [samples]" << std::endl;
+		return 1;
+	}
+
+	HeadlessContext context;
+	if (!context.Init(4, 5)) {
+		return 1;
+	}
+	std::cout << glGetString(GL_VENDOR) << ' ' << glGetString(GL_RENDERER) << std::endl;
+
+	GLuint tex_output;
+	glGenTextures(1, &tex_output);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, tex_output);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glBindImageTexture(0, tex_output, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	const Scene scenes[] = {
+		{ "cornell", CornellScene, { 0, 0, 16 }, { 0, 0, 0 } },
+		{ "field", []() { return SphereField(); }, { 0, 1.5f, 8 }, { 0, -0.25f, 0 } },
+		{ "fog", FogBox, { 0, 0, 16 }, { 0, 0, 0 } }
+	};
+	const std::pair<const char*, std::string> samplings[] = {
+		{ "rejection", "#define REJECTION_SAMPLING\n" },
+		{ "closed", "" }
+	};
+
+	const Tile& tile = TILES[0];
+	FrameUniforms frame;
+	frame.Block().skybox_active = false;
+	frame.Block().n_instances = 0;
+	frame.Block().SetChunk(glm::ivec2(0, 0), glm::ivec2(width, height));
+	RayStats stats;
+
+	std::cout << samples << " spp at " << width << 'x' << height << std::endl;
+	std::cout << std::setw(8) << "scene" << std::setw(11) << "sampling" << std::setw(10) << "s" << std::setw(10) << "SPS"
+		<< std::setw(11) << "Mrays/s" << std::setw(10) << "speedup" << std::setw(12) << "dims/path" << std::setw(13) << "sphere tries"
+		<< std::setw(12) << "disk tries" << std::setw(10) << "mean" << std::endl;
+	for (const Scene& scene : scenes) {
+		std::vector<Shape> obj = scene.build();
+		Lights::Tag(obj);
+		std::vector<BvhNode> bvh = Bvh::Build(obj);
+		GLuint SSBO_scene[2];
+		glGenBuffers(2, SSBO_scene);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_scene[0]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, obj.size() * sizeof(Shape), obj.data(), GL_STATIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_scene[1]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bvh.size() * sizeof(BvhNode), bvh.data(), GL_STATIC_DRAW);
+		Lights lights(obj);
+
+		// A wide aperture, so every camera ray samples the lens.
+		Camera cam(scene.eye, scene.target, { 0,1,0 }, 30.0f, (float)width / (float)height, 0.1f);
+		cam.Bind(frame.Block());
+		const std::string defines = tile.Defines() + RayVariant::ForScene(obj, false, false).Defines();
+
+		std::vector<Result> results;
+		for (const auto& sampling : samplings) {
+			Result r;
+			Shader<ShaderType::COMPUTE> compshdr("raycompute.comp", defines + sampling.second);
+			Shader<ShaderType::COMPUTE> counting("raycompute.comp", defines + sampling.second + RayStats::Defines());
+
+			// Warm up, the first dispatch pays for the driver's own compilation.
+			compshdr.use();
+			frame.Block().iteration = 0;
+			frame.Commit();
+			tile.Dispatch(width, height);
+			Reset(tex_output, width, height);
+
+			auto start = std::chrono::steady_clock::now();
+			for (int s = 0; s < samples; s++) {
+				frame.Block().iteration = s;
+				frame.Commit();
+				tile.Dispatch(width, height);
+				glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+			}
+			glFinish();
+			r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			r.mean = Mean(tex_output, width, height);
+
+			counting.use();
+			stats.Read();
+			frame.Block().iteration = samples;
+			frame.Commit();
+			tile.Dispatch(width, height);
+			r.counts = stats.Read();
+			results.push_back(r);
+		}
+
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			const RayStats::Counts& c = r.counts;
+			const uint64_t rays = c[RayStats::RAYS] + c[RayStats::SHADOW_RAYS];
+			std::cout << std::setw(8) << scene.name << std::setw(11) << samplings[i].first << std::setw(10) << r.seconds
+				<< std::setw(10) << samples / r.seconds << std::setw(11) << rays * samples / r.seconds * 1e-6
+				<< std::setw(10) << results[0].seconds / r.seconds << std::setw(12) << Ratio(c[RayStats::DIMENSIONS], c[RayStats::PRIMARY])
+				<< std::setw(13) << c[RayStats::SPHERE_TRIES] << std::setw(12) << c[RayStats::DISK_TRIES] << std::setw(10) << r.mean << std::endl;
+		}
+		glDeleteBuffers(2, SSBO_scene);
+	}
+
+	glDeleteTextures(1, &tex_output);
+	return 0;
+}
@@ -0,0 +1,306 @@
+#include <iostream>
+#include "glad/glad.h"
+
+#include "HeadlessContext.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "Lights.h"
+#include "Bvh.h"
+#include "Tile.h"
+#include "FrameUniforms.h"
+#include "RayVariant.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+/*
+ * Fixed scenes rendered for a fixed sample budget, from the same random numbers
+ * every run, written out as JSON to track throughput across commits:
+ *   cornell   the interactive viewer's Cornell box
+ *   field     the random sphere field, lambert, metal and glass
+ *   fog       the Cornell box filled with volumes
+ *   stress    a cloud of a million diffuse spheres in the Cornell box (--stress sets the count)
+ *   lamps     the Cornell box lit by ten thousand small lamps instead of one (--lamps sets the count)
+ * Each scene gets its own RayVariant and one warm up sample. A frame is one sample
+ * over the whole image, finished before the next. The image mean is there to show a
+ * change in throughput came with a change in output, or did not.
+ * With --baseline the samples per second are compared against an earlier run's
+ * JSON, any scene slower by more than --tolerance (default 0.1) fails the run.
+ * Usage: TracerBench [-w width] [-h height] [-s samples] [-o results.json] [--scene name]... [--stress count] [--lamps count] [--baseline old.json] [--tolerance fraction]
+ */
+
+namespace {
+
+	struct Scene {
+		const char* name;
+		std::function<std::vector<Shape>()> build;
+		glm::vec3 eye;
+		glm::vec3 target;
+		float fov;
+	};
+
+	struct Result {
+		std::string name;
+		size_t shapes;
+		size_t nodes;
+		double build_ms;
+		double compile_ms;
+		double samples_per_s;	// pixel samples
+		double ms_per_frame;
+		double min_ms;
+		double max_ms;
+		double gpu_mb;			// scene, bvh, lights and image
+		double peak_rss_mb;
+		double mean;
+	};
+
+	double Milliseconds(std::chrono::steady_clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	double PeakRssMb() {
+		rusage usage = {};
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss / 1024.0;	// kilobytes on Linux
+	}
+
+	double Mean(GLuint tex_output, int width, int height) {
+		std::vector<float> image(width * height * 4);
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, image.data());
+		double sum = 0.0;
+		for (size_t i = 0; i < image.size(); i += 4) {
+			sum += image[i] + image[i + 1] + image[i + 2];
+		}
+		return sum / (3.0 * width * height);
+	}
+
+	void Reset(GLuint tex_output, int width, int height) {
+		std::vector<float> black(width * height * 4, 0.0f);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, black.data());
+		glFinish();
+	}
+
+	// Samples per second by scene name from a file this wrote, one scene per line.
+	std::map<std::string, double> ReadBaseline(const std::string& path) {
+		std::map<std::string, double> baseline;
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line)) {
+			const std::string name_key = "\"name\": \"";
+			const std::string sps_key = "\"samples_per_s\": ";
+			size_t name = line.find(name_key);
+			size_t sps = line.find(sps_key);
+			if (name == std::string::npos || sps == std::string::npos) continue;
+			name += name_key.size();
+			baseline[line.substr(name, line.find('"', name) - name)] = std::atof(line.c_str() + sps + sps_key.size());
+		}
+		return baseline;
+	}
+
+	void WriteJson(std::ostream& out, int width, int height, int samples, const std::vector<Result>& results) {
+		out << "{\n";
+		out << "  \"renderer\": \"" << glGetString(GL_RENDERER) << "\",\n";
+		out << "  \"width\": " << width << ", \"height\": " << height << ", \"samples\": " << samples << ",\n";
+		out << "  \"scenes\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			out << "    {\"name\": \"" << r.name << "\", \"shapes\": " << r.shapes << ", \"bvh_nodes\": " << r.nodes
+				<< ", \"build_ms\": " << r.build_ms << ", \"compile_ms\": " << r.compile_ms
+				<< ", \"samples_per_s\": " << r.samples_per_s << ", \"ms_per_frame\": " << r.ms_per_frame
+				<< ", \"min_ms\": " << r.min_ms << ", \"max_ms\": " << r.max_ms
+				<< ", \"gpu_mb\": " << r.gpu_mb << ", \"peak_rss_mb\": " << r.peak_rss_mb << ", \"mean\": " << r.mean << '}'
+				<< (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		out << "  ]\n}\n";
+	}
+}
+
+int main(int argc, char** argv) {
+
+	int width = 320;
+	int height = 180;
+	int samples = 8;
+	int stress = 1000000;
+	int lamps = 10000;
+	double tolerance = 0.1;
+	std::string output;
+	std::string baseline_path;
+	std::vector<std::string> only;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-w" && i + 1 < argc) {
+			width = std::atoi(argv[++i]);
+		} else if (arg == "-h" && i + 1 < argc) {
+			height = std::atoi(argv[++i]);
+		} else if (arg == "-s" && i + 1 < argc) {
+			samples = std::atoi(argv[++i]);
+		} else if (arg == "-o" && i + 1 < argc) {
+			output = argv[++i];
+		} else if (arg == "--scene" && i + 1 < argc) {
+			only.push_back(argv[++i]);
+		} else if (arg == "--stress" && i + 1 < argc) {
+			stress = std::atoi(argv[++i]);
+		} else if (arg == "--lamps" && i + 1 < argc) {
+			lamps = std::atoi(argv[++i]);
+		} else if (arg == "--baseline" && i + 1 < argc) {
+			baseline_path = argv[++i];
+		} else if (arg == "--tolerance" && i + 1 < argc) {
+			tolerance = std::atof(argv[++i]);
+		} else {
+			width = 0;
+			break;
+		}
+	}
+	if (width <= 0 || height <= 0 || samples <= 0 || stress <= 0 || lamps <= 0) {
+		std::cerr << "Usage: TracerBench [-w width] [-h height] [-s samples] [-o results.json] [--scene name]... [--stress count] [--lamps count] [--baseline old.json] [--tolerance fraction]" << std::endl;
+		return 1;
+	}
+
+	const Scene scenes[] = {
+		{ "cornell", CornellScene, { 0, 0, 16 }, { 0, 0, 0 }, 30.0f },
+		{ "field", []() { return SphereField(); }, { 0, 1.5f, 8 }, { 0, -0.25f, 0 }, 30.0f },
+		{ "fog", FogBox, { 0, 0, 16 }, { 0, 0, 0 }, 30.0f },
+		{ "stress", [stress]() {
+			std::vector<Shape> obj = CornellScene();
+			std::vector<Shape> cloud = SphereCloud(stress, 2.5f);
+			obj.insert(obj.end(), cloud.begin(), cloud.end());
+			return obj;
+		}, { 0, 0, 16 }, { 0, 0, 0 }, 30.0f },
+		{ "lamps", [lamps]() { return LampCloud(lamps); }, { 0, 0, 16 }, { 0, 0, 0 }, 30.0f }
+	};
+	for (const std::string& name : only) {
+		if (std::none_of(std::begin(scenes), std::end(scenes), [&name](const Scene& s) { return name == s.name; })) {
+			std::cerr << "ERR::BENCH::UNKNOWN_SCENE " << name << std::endl;
+			return 1;
+		}
+	}
+
+	HeadlessContext context;
+	if (!context.Init(4, 5)) {
+		return 1;
+	}
+	std::cout << glGetString(GL_VENDOR) << ' ' << glGetString(GL_RENDERER) << std::endl;
+
+	GLuint tex_output;
+	glGenTextures(1, &tex_output);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, tex_output);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glBindImageTexture(0, tex_output, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	const Tile& tile = TILES[0];
+	FrameUniforms frame;
+	frame.Block().skybox_active = false;
+	frame.Block().n_instances = 0;
+	frame.Block().SetChunk(glm::ivec2(0, 0), glm::ivec2(width, height));
+
+	std::vector<Result> results;
+	for (const Scene& scene : scenes) {
+		if (!only.empty() && std::find(only.begin(), only.end(), scene.name) == only.end()) continue;
+		Result r;
+		r.name = scene.name;
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<Shape> obj = scene.build();
+		Lights::Tag(obj);
+		std::vector<BvhNode> bvh = Bvh::Build(obj);
+		r.build_ms = Milliseconds(start);
+		r.shapes = obj.size();
+		r.nodes = bvh.size();
+
+		GLuint SSBO_scene[2];
+		glGenBuffers(2, SSBO_scene);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_scene[0]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, obj.size() * sizeof(Shape), obj.data(), GL_STATIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_scene[1]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bvh.size() * sizeof(BvhNode), bvh.data(), GL_STATIC_DRAW);
+		Lights lights(obj);
+		r.gpu_mb = (obj.size() * sizeof(Shape) + bvh.size() * sizeof(BvhNode) + lights.Tree().size() * sizeof(LightNode)
+			+ (size_t)width * height * 4 * sizeof(float)) / (1024.0 * 1024.0);
+
+		start = std::chrono::steady_clock::now();
+		Shader<ShaderType::COMPUTE> compshdr("raycompute.comp", tile.Defines() + RayVariant::ForScene(obj, false, false).Defines());
+		r.compile_ms = Milliseconds(start);
+
+		Camera cam(scene.eye, scene.target, { 0,1,0 }, scene.fov, (float)width / (float)height);
+		cam.Bind(frame.Block());
+
+		// Warm up, the first dispatch pays for the driver's own compilation.
+		compshdr.use();
+		frame.Block().iteration = 0;
+		frame.Commit();
+		tile.Dispatch(width, height);
+		Reset(tex_output, width, height);
+
+		std::vector<double> frames;
+		start = std::chrono::steady_clock::now();
+		for (int s = 0; s < samples; s++) {
+			auto frame_start = std::chrono::steady_clock::now();
+			frame.Block().iteration = s;
+			frame.Commit();
+			tile.Dispatch(width, height);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+			glFinish();
+			frames.push_back(Milliseconds(frame_start));
+		}
+		const double seconds = Milliseconds(start) * 1e-3;
+		r.samples_per_s = (double)width * height * samples / seconds;
+		r.ms_per_frame = seconds * 1e3 / samples;
+		r.min_ms = *std::min_element(frames.begin(), frames.end());
+		r.max_ms = *std::max_element(frames.begin(), frames.end());
+		r.mean = Mean(tex_output, width, height);
+		r.peak_rss_mb = PeakRssMb();
+		results.push_back(r);
+
+		std::cout << std::setw(8) << r.name << std::setw(10) << r.shapes << " shapes " << std::setw(10) << r.ms_per_frame << " ms/frame "
+			<< std::setw(10) << r.samples_per_s * 1e-6 << " Msamples/s  mean " << r.mean << std::endl;
+		glDeleteBuffers(2, SSBO_scene);
+	}
+
+	int status = 0;
+	if (!output.empty()) {
+		std::ofstream file(output);
+		WriteJson(file, width, height, samples, results);
+		if (!file) {
+			std::cerr << "ERR::BENCH::WRITE_FAIL " << output << std::endl;
+			status = 1;
+		}
+	} else {
+		WriteJson(std::cout, width, height, samples, results);
+	}
+
+	if (!baseline_path.empty()) {
+		std::map<std::string, double> baseline = ReadBaseline(baseline_path);
+		if (baseline.empty()) {
+			std::cerr << "ERR::BENCH::BASELINE_READ_FAIL " << baseline_path << std::endl;
+			status = 1;
+		}
+		for (const Result& r : results) {
+			auto b = baseline.find(r.name);
+			if (b == baseline.end() || b->second <= 0.0) continue;
+			const double change = r.samples_per_s / b->second - 1.0;
+			std::cout << std::setw(8) << r.name << std::setw(10) << std::showpos << change * 100.0 << std::noshowpos << " % against baseline" << std::endl;
+			if (change < -tolerance) {
+				std::cerr << "ERR::BENCH::REGRESSION " << r.name << std::endl;
+				status = 1;
+			}
+		}
+	}
+
+	glDeleteTextures(1, &tex_output);
+	return status;
+}
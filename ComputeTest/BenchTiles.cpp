@@ -0,0 +1,164 @@
+#include <iostream>
+#include "glad/glad.h"
+
+#include "HeadlessContext.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "Lights.h"
+#include "Bvh.h"
+#include "Tile.h"
+#include "FrameUniforms.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <vector>
+
+/*
+ * Samples per second of raycompute.comp on the Cornell box for every workgroup
+ * shape in Tile.h, next to the old one invocation per group as a baseline.
+ * Each run draws the same random numbers, so every tiled image must match the
+ * first one bit for bit, and every pixel must have been written (alpha is 1).
+ * A partial tile traced twice or not at all fails one or the other. The 1x1
+ * baseline is only checked for coverage: drivers may compile it as scalar code
+ * that rounds differently, and a path tracer turns one ulp into another path.
+ * Usage: TracerTileBench [width height] [samples]
+ */
+
+namespace {
+
+	const Tile BASELINE = { "1x1", 1, 1 };
+
+	struct Result {
+		double seconds;
+		std::vector<float> image;
+	};
+
+	bool Covered(const std::vector<float>& rgba) {
+		for (size_t i = 3; i < rgba.size(); i += 4) {
+			if (rgba[i] != 1.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	Result Run(const Tile& tile, int width, int height, int samples, GLuint tex_output) {
+		Shader<ShaderType::COMPUTE> compshdr("raycompute.comp", tile.Defines());
+		Camera cam({ 0,0,16 }, { 0,0,0 }, { 0,1,0 }, 30.0f, (float)width / (float)height);
+		FrameUniforms frame;
+		cam.Bind(frame.Block());
+		frame.Block().skybox_active = false;
+		frame.Block().SetChunk(glm::ivec2(0, 0), glm::ivec2(width, height));
+		frame.Block().time = 0.0f;
+
+		// Warm up, the first dispatch pays for the driver's own compilation.
+		frame.Block().iteration = 0;
+		frame.Commit();
+		compshdr.use();
+		tile.Dispatch(width, height);
+		glFinish();
+
+		// Reset to a black image, every configuration traces the same paths.
+		std::vector<float> black(width * height * 4, 0.0f);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, black.data());
+		glFinish();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int sample = 0; sample < samples; sample++) {
+			frame.Block().iteration = sample;
+			frame.Commit();
+			tile.Dispatch(width, height);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+		glFinish();
+
+		Result r;
+		r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		r.image.resize(width * height * 4);
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, r.image.data());
+		return r;
+	}
+}
+
+int main(int argc, char** argv) {
+
+	// Deliberately not a multiple of 8 or 32, so the last row and column of tiles are partial.
+	int width = 330;
+	int height = 186;
+	int samples = 4;
+	if (argc > 2) {
+		width = std::atoi(argv[1]);
+		height = std::atoi(argv[2]);
+	}
+	if (argc > 3) {
+		samples = std::atoi(argv[3]);
+	}
+	if (width <= 0 || height <= 0 || samples <= 0) {
+		std::cerr << "Usage: TracerTileBench [width height] [samples]" << std::endl;
+		return 1;
+	}
+
+	HeadlessContext context;
+	if (!context.Init(4, 5)) {
+		return 1;
+	}
+	std::cout << glGetString(GL_VENDOR) << ' ' << glGetString(GL_RENDERER) << std::endl;
+
+	GLuint tex_output;
+	glGenTextures(1, &tex_output);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, tex_output);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glBindImageTexture(0, tex_output, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	std::vector<Shape> obj = CornellScene();
+	Lights::Tag(obj);
+	std::vector<BvhNode> bvh = Bvh::Build(obj);
+	GLuint SSBO_scene[2];
+	glGenBuffers(2, SSBO_scene);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_scene[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, obj.size() * sizeof(Shape), obj.data(), GL_STATIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_scene[1]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, bvh.size() * sizeof(BvhNode), bvh.data(), GL_STATIC_DRAW);
+	Lights lights(obj);
+
+	std::cout << samples << " spp at " << width << 'x' << height << std::endl;
+	std::cout << std::setw(8) << "tile" << std::setw(10) << "groups" << std::setw(10) << "idle %" << std::setw(10) << "s"
+		<< std::setw(10) << "SPS" << std::setw(12) << "Msamples/s" << std::setw(10) << "speedup" << std::setw(9) << "covered" << std::setw(8) << "match" << std::endl;
+
+	std::vector<Tile> tiles = { BASELINE };
+	tiles.insert(tiles.end(), TILES, TILES + N_TILES);
+
+	int status = 0;
+	Result baseline, reference;
+	for (size_t i = 0; i < tiles.size(); i++) {
+		const Tile& tile = tiles[i];
+		Result r = Run(tile, width, height, samples, tex_output);
+		if (i == 0) {
+			baseline = r;
+		} else if (i == 1) {
+			reference = r;
+		}
+		bool covered = Covered(r.image);
+		bool match = (i == 0) || (r.image == reference.image);
+		if (!covered || !match) {
+			status = 1;
+		}
+
+		const double groups = (double)tile.GroupsX(width) * tile.GroupsY(height);
+		const double idle = 1.0 - (double)width * height / (groups * tile.w * tile.h);
+		std::cout << std::setw(8) << tile.name << std::setw(10) << (long long)groups << std::setw(10) << std::setprecision(3) << idle * 100.0
+			<< std::setw(10) << r.seconds << std::setw(10) << samples / r.seconds << std::setw(12) << (double)width * height * samples / r.seconds * 1e-6
+			<< std::setw(10) << baseline.seconds / r.seconds << std::setw(9) << (covered ? "yes" : "NO") << std::setw(8) << ((i == 0) ? "-" : (match ? "yes" : "NO")) << std::endl;
+	}
+
+	glDeleteBuffers(2, SSBO_scene);
+	glDeleteTextures(1, &tex_output);
+	return status;
+}
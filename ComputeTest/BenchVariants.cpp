@@ -0,0 +1,165 @@
+#include <iostream>
+#include "glad/glad.h"
+
+#include "HeadlessContext.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "Lights.h"
+#include "Bvh.h"
+#include "Tile.h"
+#include "FrameUniforms.h"
+#include "RayVariant.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <vector>
+
+/*
+ * raycompute.comp with every feature compiled in, against the variant for the
+ * Cornell box's own materials and shapes, and that variant cut to 8 bounces.
+ * Full and scene variants trace the same paths from the same random numbers, so their
+ * means should agree; the short one is biased, as paths cut off at MAX_DEPTH
+ * still add their throughput. Compile is the first lookup in ComputeVariants,
+ * cached the second one.
+ * Usage: TracerVariantBench [width height] [samples]
+ */
+
+namespace {
+
+	struct Result {
+		double compile_ms;
+		double cached_ms;
+		double seconds;
+		double mean;
+	};
+
+	void Reset(GLuint tex_output, int width, int height) {
+		std::vector<float> black(width * height * 4, 0.0f);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, black.data());
+		glFinish();
+	}
+
+	double Mean(GLuint tex_output, int width, int height) {
+		std::vector<float> image(width * height * 4);
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, image.data());
+		double sum = 0.0;
+		for (size_t i = 0; i < image.size(); i += 4) {
+			sum += image[i] + image[i + 1] + image[i + 2];
+		}
+		return sum / (3.0 * width * height);
+	}
+
+	double Milliseconds(std::chrono::steady_clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+}
+
+int main(int argc, char** argv) {
+
+	int width = 320;
+	int height = 180;
+	int samples = 4;
+	if (argc > 2) {
+		width = std::atoi(argv[1]);
+		height = std::atoi(argv[2]);
+	}
+	if (argc > 3) {
+		samples = std::atoi(argv[3]);
+	}
+	if (width <= 0 || height <= 0 || samples <= 0) {
+		std::cerr << "Usage: TracerVariantBench [width height] [samples]" << std::endl;
+		return 1;
+	}
+
+	HeadlessContext context;
+	if (!context.Init(4, 5)) {
+		return 1;
+	}
+	std::cout << glGetString(GL_VENDOR) << ' ' << glGetString(GL_RENDERER) << std::endl;
+
+	GLuint tex_output;
+	glGenTextures(1, &tex_output);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, tex_output);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glBindImageTexture(0, tex_output, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	std::vector<Shape> obj = CornellScene();
+	Lights::Tag(obj);
+	std::vector<BvhNode> bvh = Bvh::Build(obj);
+	GLuint SSBO_scene[2];
+	glGenBuffers(2, SSBO_scene);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_scene[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, obj.size() * sizeof(Shape), obj.data(), GL_STATIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_scene[1]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, bvh.size() * sizeof(BvhNode), bvh.data(), GL_STATIC_DRAW);
+	Lights lights(obj);
+
+	Camera cam({ 0,0,16 }, { 0,0,0 }, { 0,1,0 }, 30.0f, (float)width / (float)height);
+	FrameUniforms frame;
+	cam.Bind(frame.Block());
+	frame.Block().skybox_active = false;
+	frame.Block().n_instances = 0;
+	frame.Block().SetChunk(glm::ivec2(0, 0), glm::ivec2(width, height));
+
+	const Tile& tile = TILES[0];
+	RayVariant scene = RayVariant::ForScene(obj, false, false);
+	RayVariant shallow = scene;
+	shallow.max_depth = 8;
+	const std::pair<const char*, RayVariant> variants[] = {
+		{ "full", RayVariant() },
+		{ "scene", scene },
+		{ "depth 8", shallow }
+	};
+
+	ComputeVariants programs("raycompute.comp");
+	std::vector<Result> results;
+	for (const auto& v : variants) {
+		const std::string defines = tile.Defines() + v.second.Defines();
+		Result r;
+		auto start = std::chrono::steady_clock::now();
+		Shader<ShaderType::COMPUTE>& compshdr = programs.get(defines);
+		r.compile_ms = Milliseconds(start);
+		start = std::chrono::steady_clock::now();
+		programs.get(defines);
+		r.cached_ms = Milliseconds(start);
+
+		// Warm up, the first dispatch pays for the driver's own compilation.
+		compshdr.use();
+		frame.Block().iteration = 0;
+		frame.Commit();
+		tile.Dispatch(width, height);
+		Reset(tex_output, width, height);
+
+		start = std::chrono::steady_clock::now();
+		for (int s = 0; s < samples; s++) {
+			frame.Block().iteration = s;
+			frame.Commit();
+			tile.Dispatch(width, height);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+		glFinish();
+		r.seconds = Milliseconds(start) * 1e-3;
+		r.mean = Mean(tex_output, width, height);
+		results.push_back(r);
+	}
+
+	std::cout << samples << " spp at " << width << 'x' << height << ", scene variant: " << scene.Name() << std::endl;
+	std::cout << std::setw(10) << "variant" << std::setw(12) << "compile ms" << std::setw(11) << "cached ms" << std::setw(10) << "s"
+		<< std::setw(10) << "SPS" << std::setw(10) << "speedup" << std::setw(10) << "mean" << std::endl;
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		std::cout << std::setw(10) << variants[i].first << std::setw(12) << r.compile_ms << std::setw(11) << r.cached_ms << std::setw(10) << r.seconds
+			<< std::setw(10) << samples / r.seconds << std::setw(10) << results[0].seconds / r.seconds << std::setw(10) << r.mean << std::endl;
+	}
+
+	glDeleteBuffers(2, SSBO_scene);
+	glDeleteTextures(1, &tex_output);
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include "glad/glad.h"
+
+#include "HeadlessContext.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "Lights.h"
+#include "Bvh.h"
+#include "Tile.h"
+#include "WavefrontTracer.h"
+#include "FrameUniforms.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <vector>
+
+/*
+ * Megakernel against wavefront path tracing, with per material queues and with
+ * counting sort shading, on the Cornell box at the same resolution, samples and
+ * seed. Both trace the same paths, but as separately
+ * compiled programs they may round differently and so diverge per pixel; the
+ * image means are printed to show neither is biased against the other.
+ * The per bounce queue lengths, i.e. the material bin sizes, of the last
+ * sorted sample follow.
+ * Usage: TracerWavefrontBench [width height] [samples]
+ */
+
+namespace {
+
+	struct Result {
+		double seconds;
+		double mean;
+	};
+
+	void Reset(GLuint tex_output, int width, int height) {
+		std::vector<float> black(width * height * 4, 0.0f);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_FLOAT, black.data());
+		glFinish();
+	}
+
+	double Mean(GLuint tex_output, int width, int height) {
+		std::vector<float> image(width * height * 4);
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glBindTexture(GL_TEXTURE_2D, tex_output);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, image.data());
+		double sum = 0.0;
+		for (size_t i = 0; i < image.size(); i += 4) {
+			sum += image[i] + image[i + 1] + image[i + 2];
+		}
+		return sum / (3.0 * width * height);
+	}
+
+	template <class F>
+	Result Time(int samples, F sample) {
+		// Warm up, the first dispatch pays for the driver's own compilation.
+		sample(0);
+		glFinish();
+		auto start = std::chrono::steady_clock::now();
+		for (int s = 0; s < samples; s++) {
+			sample(s);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+		}
+		glFinish();
+		return { std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 0.0 };
+	}
+}
+
+int main(int argc, char** argv) {
+
+	int width = 320;
+	int height = 180;
+	int samples = 4;
+	if (argc > 2) {
+		width = std::atoi(argv[1]);
+		height = std::atoi(argv[2]);
+	}
+	if (argc > 3) {
+		samples = std::atoi(argv[3]);
+	}
+	if (width <= 0 || height <= 0 || samples <= 0) {
+		std::cerr << "Usage: TracerWavefrontBench [width height] [samples]" << std::endl;
+		return 1;
+	}
+
+	HeadlessContext context;
+	if (!context.Init(4, 5)) {
+		return 1;
+	}
+	std::cout << glGetString(GL_VENDOR) << ' ' << glGetString(GL_RENDERER) << std::endl;
+
+	GLuint tex_output;
+	glGenTextures(1, &tex_output);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, tex_output);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	glBindImageTexture(0, tex_output, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	std::vector<Shape> obj = CornellScene();
+	Lights::Tag(obj);
+	std::vector<BvhNode> bvh = Bvh::Build(obj);
+	GLuint SSBO_scene[2];
+	glGenBuffers(2, SSBO_scene);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_scene[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, obj.size() * sizeof(Shape), obj.data(), GL_STATIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_scene[1]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, bvh.size() * sizeof(BvhNode), bvh.data(), GL_STATIC_DRAW);
+	Lights lights(obj);
+
+	Camera cam({ 0,0,16 }, { 0,0,0 }, { 0,1,0 }, 30.0f, (float)width / (float)height);
+	const Tile& tile = TILES[0];
+	Shader<ShaderType::COMPUTE> compshdr("raycompute.comp", tile.Defines());
+	FrameUniforms frame;
+	cam.Bind(frame.Block());
+	frame.Block().skybox_active = false;
+	frame.Block().n_instances = 0;
+	frame.Block().SetChunk(glm::ivec2(0, 0), glm::ivec2(width, height));
+
+	WavefrontTracer wf(width * height);
+
+	Reset(tex_output, width, height);
+	Result mega = Time(samples, [&](int s) {
+		frame.Block().iteration = s;
+		frame.Commit();
+		compshdr.use();
+		tile.Dispatch(width, height);
+	});
+	mega.mean = Mean(tex_output, width, height);
+
+	Reset(tex_output, width, height);
+	Result wave = Time(samples, [&](int s) {
+		frame.Block().iteration = s;
+		wf.Trace(frame);
+	});
+	wave.mean = Mean(tex_output, width, height);
+
+	wf.SetShading(WavefrontTracer::Shading::SORTED);
+	Reset(tex_output, width, height);
+	Result sorted = Time(samples, [&](int s) {
+		frame.Block().iteration = s;
+		wf.Trace(frame);
+	});
+	sorted.mean = Mean(tex_output, width, height);
+
+	std::cout << samples << " spp at " << width << 'x' << height << std::endl;
+	std::cout << std::setw(12) << "kernel" << std::setw(10) << "s" << std::setw(10) << "SPS" << std::setw(12) << "Msamples/s"
+		<< std::setw(10) << "speedup" << std::setw(10) << "mean" << std::endl;
+	for (const auto& row : { std::make_pair("megakernel", mega), std::make_pair("wavefront", wave), std::make_pair("sorted", sorted) }) {
+		const Result& r = row.second;
+		std::cout << std::setw(12) << row.first << std::setw(10) << r.seconds << std::setw(10) << samples / r.seconds
+			<< std::setw(12) << (double)width * height * samples / r.seconds * 1e-6 << std::setw(10) << mega.seconds / r.seconds
+			<< std::setw(10) << r.mean << std::endl;
+	}
+
+	// Queue lengths show how fast paths drain and how the material queues split each bounce.
+	std::vector<GLuint> counts = wf.Counts();
+	std::cout << std::endl << std::setw(8) << "bounce" << std::setw(10) << "extended" << std::setw(10) << "survived"
+		<< std::setw(10) << "lambert" << std::setw(10) << "metal" << std::setw(12) << "dielectric" << std::setw(10) << "volume" << std::endl;
+	for (int depth = 0; depth < WavefrontTracer::MAX_DEPTH; depth++) {
+		const GLuint* row = &counts[depth * WavefrontTracer::COUNTS];
+		if (row[0] == 0) break;
+		std::cout << std::setw(8) << depth << std::setw(10) << row[0] << std::setw(10) << row[1] << std::setw(10) << row[2]
+			<< std::setw(10) << row[3] << std::setw(12) << row[4] << std::setw(10) << row[5] << std::endl;
+	}
+
+	glDeleteBuffers(2, SSBO_scene);
+	glDeleteTextures(1, &tex_output);
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include "BlueNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+	// Energy of a binary pattern: a Gaussian around every set pixel, wrapping at the edges.
+	class Energy {
+	public:
+		explicit Energy(int size) : size(size), kernel(size * size), energy(size * size, 0.0f), set(size * size, false) {
+			const float sigma = 1.5f;
+			for (int y = 0; y < size; y++) {
+				for (int x = 0; x < size; x++) {
+					int dx = std::min(x, size - x);
+					int dy = std::min(y, size - y);
+					kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+				}
+			}
+		}
+
+		void Flip(int p) {
+			set[p] = !set[p];
+			const float sign = set[p] ? 1.0f : -1.0f;
+			const int px = p % size;
+			const int py = p / size;
+			for (int y = 0; y < size; y++) {
+				const int ky = (y - py + size) % size;
+				for (int x = 0; x < size; x++) {
+					energy[y * size + x] += sign * kernel[ky * size + (x - px + size) % size];
+				}
+			}
+		}
+
+		// Set pixel with the most energy.
+		int TightestCluster() const {
+			int best = -1;
+			for (int p = 0; p < (int)set.size(); p++) {
+				if (set[p] && (best < 0 || energy[p] > energy[best])) best = p;
+			}
+			return best;
+		}
+
+		// Unset pixel with the least.
+		int LargestVoid() const {
+			int best = -1;
+			for (int p = 0; p < (int)set.size(); p++) {
+				if (!set[p] && (best < 0 || energy[p] < energy[best])) best = p;
+			}
+			return best;
+		}
+
+	private:
+		int size;
+		std::vector<float> kernel;
+		std::vector<float> energy;
+		std::vector<bool> set;
+	};
+}
+
+std::vector<float> BlueNoise::Generate(int size, unsigned seed) {
+	const int n = size * size;
+	const int initial = std::max(1, n / 10);
+
+	// A tenth of the pixels at random, then moved from clusters into voids until settled.
+	std::vector<int> order(n);
+	for (int p = 0; p < n; p++) {
+		order[p] = p;
+	}
+	std::shuffle(order.begin(), order.end(), std::default_random_engine(seed));
+	Energy pattern(size);
+	for (int i = 0; i < initial; i++) {
+		pattern.Flip(order[i]);
+	}
+	for (;;) {
+		int cluster = pattern.TightestCluster();
+		pattern.Flip(cluster);
+		int gap = pattern.LargestVoid();
+		pattern.Flip(gap);
+		if (gap == cluster) break;
+	}
+
+	// Ranks below the initial pattern by taking it apart, above it by filling voids.
+	std::vector<int> rank(n);
+	Energy down = pattern;
+	for (int r = initial - 1; r >= 0; r--) {
+		int p = down.TightestCluster();
+		rank[p] = r;
+		down.Flip(p);
+	}
+	for (int r = initial; r < n; r++) {
+		int p = pattern.LargestVoid();
+		rank[p] = r;
+		pattern.Flip(p);
+	}
+
+	std::vector<float> mask(n);
+	for (int p = 0; p < n; p++) {
+		mask[p] = (rank[p] + 0.5f) / n;
+	}
+	return mask;
+}
+
+BlueNoise::BlueNoise(unsigned seed) : texture(0) {
+	std::vector<float> mask = Generate(SIZE, seed);
+
+	// Off unit 0, where the output image lives.
+	glActiveTexture(GL_TEXTURE1);
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, SIZE, SIZE, 0, GL_RED, GL_FLOAT, mask.data());
+	glActiveTexture(GL_TEXTURE0);
+	glBindImageTexture(BINDING, texture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+}
+
+BlueNoise::~BlueNoise() {
+	glDeleteTextures(1, &texture);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+/*
+ * Blue noise dither mask for the bluenoise sampler, made by Ulichney's void and
+ * cluster method: every pixel gets a rank, the order a dither pattern would
+ * turn it on in, such that the pixels of any prefix are spread as evenly as
+ * possible. Ranks become thresholds in [0, 1) in an r32f image, bound to image
+ * unit BINDING for random.glsl. Built at startup, a 64x64 mask takes a few ms.
+ */
+class BlueNoise
+{
+public:
+	static const int SIZE = 64;
+	static const GLuint BINDING = 1;
+
+	explicit BlueNoise(unsigned seed = 1);
+	~BlueNoise();
+
+	BlueNoise(const BlueNoise&) = delete;
+	BlueNoise& operator=(const BlueNoise&) = delete;
+
+	// Thresholds of a `size` x `size` mask, row by row, tiling without seams.
+	static std::vector<float> Generate(int size, unsigned seed);
+
+private:
+	GLuint texture;
+};
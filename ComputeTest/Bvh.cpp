@@ -0,0 +1,313 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+	const float TRAVERSAL_COST = 1.0f;
+	const float INTERSECT_COST = 1.0f;
+	// Rects are flat, keep their boxes from collapsing so slab tests stay well defined.
+	const float FLAT_PAD = 1e-4f;
+
+	glm::vec3 rotateXZ(const glm::vec3& a, float angle) {
+		return glm::vec3(std::cos(angle)*a.x - std::sin(angle)*a.z, a.y, std::sin(angle)*a.x + std::cos(angle)*a.z);
+	}
+
+	struct Builder {
+		const std::vector<Aabb>& bounds;
+		std::vector<glm::vec3> centers;
+		std::vector<uint32_t>& order;
+		std::vector<BvhNode> nodes;
+
+		void MakeLeaf(uint32_t index, const Aabb& box, uint32_t first, uint32_t count) {
+			BvhNode& n = nodes[index];
+			for (int k = 0; k < 3; k++) {
+				n.bmin[k] = box.bmin[k];
+				n.bmax[k] = box.bmax[k];
+			}
+			n.offset = first;
+			n.count = count;
+		}
+
+		void Subdivide(uint32_t index, uint32_t first, uint32_t count, int depth) {
+			Aabb box, centroid_box;
+			for (uint32_t i = first; i < first + count; i++) {
+				box.Grow(bounds[order[i]]);
+				centroid_box.Grow(centers[order[i]]);
+			}
+
+			if (count <= 1 || depth >= Bvh::MAX_DEPTH - 1) {
+				MakeLeaf(index, box, first, count);
+				return;
+			}
+
+			// Binned SAH over all three axes.
+			int best_axis = -1;
+			int best_split = 0;
+			float best_cost = 1e30f;
+			glm::vec3 extent = centroid_box.bmax - centroid_box.bmin;
+			for (int axis = 0; axis < 3; axis++) {
+				if (extent[axis] <= 0.0f) continue;
+
+				Aabb bin_box[Bvh::BINS];
+				uint32_t bin_count[Bvh::BINS] = {};
+				float scale = Bvh::BINS / extent[axis];
+				for (uint32_t i = first; i < first + count; i++) {
+					int b = std::min(Bvh::BINS - 1, (int)((centers[order[i]][axis] - centroid_box.bmin[axis]) * scale));
+					bin_count[b]++;
+					bin_box[b].Grow(bounds[order[i]]);
+				}
+
+				// Sweep from the right once to get the right hand areas, then from the left.
+				float right_area[Bvh::BINS - 1];
+				uint32_t right_count[Bvh::BINS - 1];
+				Aabb acc;
+				uint32_t n = 0;
+				for (int b = Bvh::BINS - 1; b > 0; b--) {
+					acc.Grow(bin_box[b]);
+					n += bin_count[b];
+					right_area[b - 1] = acc.Area();
+					right_count[b - 1] = n;
+				}
+				acc = Aabb();
+				n = 0;
+				for (int b = 0; b < Bvh::BINS - 1; b++) {
+					acc.Grow(bin_box[b]);
+					n += bin_count[b];
+					if (n == 0 || right_count[b] == 0) continue;
+					float cost = acc.Area() * n + right_area[b] * right_count[b];
+					if (cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_split = b;
+					}
+				}
+			}
+
+			float leaf_cost = INTERSECT_COST * count;
+			float split_cost = TRAVERSAL_COST + INTERSECT_COST * best_cost / std::max(box.Area(), 1e-12f);
+
+			uint32_t mid;
+			if (best_axis >= 0 && (split_cost < leaf_cost || count > (uint32_t)Bvh::MAX_LEAF)) {
+				float scale = Bvh::BINS / extent[best_axis];
+				float lo = centroid_box.bmin[best_axis];
+				uint32_t* split = std::partition(order.data() + first, order.data() + first + count, [&](uint32_t p) {
+					return std::min(Bvh::BINS - 1, (int)((centers[p][best_axis] - lo) * scale)) <= best_split;
+				});
+				mid = (uint32_t)(split - order.data());
+			} else if (count > (uint32_t)Bvh::MAX_LEAF) {
+				// All centroids coincide, no plane separates them. Halve the range instead.
+				mid = first + count / 2;
+			} else {
+				MakeLeaf(index, box, first, count);
+				return;
+			}
+
+			uint32_t left = (uint32_t)nodes.size();
+			nodes.emplace_back();
+			Subdivide(left, first, mid - first, depth + 1);
+			uint32_t right = (uint32_t)nodes.size();
+			nodes.emplace_back();
+			Subdivide(right, mid, first + count - mid, depth + 1);
+
+			MakeLeaf(index, box, right, 0);
+		}
+	};
+}
+
+Aabb Bvh::ShapeBounds(const Shape& s) {
+	glm::vec3 A(s.A[0], s.A[1], s.A[2]);
+	glm::vec3 B(s.B[0], s.B[1], s.B[2]);
+	Aabb box;
+
+	switch (s.shape_type & 0x0000FFFFu) {
+	case (uint32_t)ShapeType::CUBOID: {
+		// Same (odd) pivot as HitCuboid: the midpoint of corner and diagonal.
+		uint32_t param;
+		std::memcpy(&param, &s.rotation, sizeof(uint32_t));
+		float theta = param / 1000.0f;
+		glm::vec3 center = (A + B) * 0.5f;
+		for (int c = 0; c < 8; c++) {
+			glm::vec3 corner = A + glm::vec3((c & 1) ? B.x : 0.0f, (c & 2) ? B.y : 0.0f, (c & 4) ? B.z : 0.0f);
+			box.Grow(center + rotateXZ(corner - center, theta));
+		}
+	}; break;
+	case (uint32_t)ShapeType::RECT: {
+		uint32_t axis;
+		std::memcpy(&axis, &s.rotation, sizeof(uint32_t));
+		glm::vec3 d = B;
+		d[axis] = 0.0f;
+		box = Aabb(glm::min(A, A + d), glm::max(A, A + d));
+		box.bmin[axis] -= FLAT_PAD;
+		box.bmax[axis] += FLAT_PAD;
+	}; break;
+	case (uint32_t)ShapeType::MESH: {
+		// Stored as is by MeshPool.
+		box = Aabb(A, B);
+	}; break;
+	default: {
+		// Negative radii make hollow spheres, the bounds are the same.
+		float r = std::abs(B.x);
+		box = Aabb(A - glm::vec3(r), A + glm::vec3(r));
+	}; break;
+	}
+	return box;
+}
+
+std::vector<BvhNode> Bvh::Build(const std::vector<Aabb>& bounds, std::vector<uint32_t>& order) {
+	order.resize(bounds.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	if (bounds.empty()) {
+		return {};
+	}
+
+	Builder b = { bounds, {}, order, {} };
+	b.centers.reserve(bounds.size());
+	for (const Aabb& box : bounds) {
+		b.centers.push_back(box.Center());
+	}
+	b.nodes.reserve(2 * bounds.size());
+	b.nodes.emplace_back();
+	b.Subdivide(0, 0, (uint32_t)bounds.size(), 0);
+	return b.nodes;
+}
+
+std::vector<BvhNode> Bvh::Build(std::vector<Shape>& shapes) {
+	std::vector<Aabb> bounds;
+	bounds.reserve(shapes.size());
+	for (const Shape& s : shapes) {
+		bounds.push_back(ShapeBounds(s));
+	}
+
+	std::vector<uint32_t> order;
+	std::vector<BvhNode> nodes = Build(bounds, order);
+
+	std::vector<Shape> sorted;
+	sorted.reserve(shapes.size());
+	for (uint32_t i : order) {
+		sorted.push_back(shapes[i]);
+	}
+	shapes.swap(sorted);
+	return nodes;
+}
+
+BvhNode Bvh::EmptyNode() {
+	BvhNode none = {};
+	for (int k = 0; k < 3; k++) {
+		none.bmin[k] = 1e30f;
+		none.bmax[k] = 1e30f;
+	}
+	return none;
+}
+
+void Bvh::Refit(std::vector<BvhNode>& nodes, const std::vector<Shape>& shapes) {
+	for (size_t i = nodes.size(); i-- > 0;) {
+		BvhNode& n = nodes[i];
+		Aabb box;
+		if (n.count > 0) {
+			for (uint32_t p = n.offset; p < n.offset + n.count; p++) {
+				box.Grow(ShapeBounds(shapes[p]));
+			}
+		} else {
+			const BvhNode& l = nodes[i + 1];
+			const BvhNode& r = nodes[n.offset];
+			box = Aabb(glm::vec3(l.bmin[0], l.bmin[1], l.bmin[2]), glm::vec3(l.bmax[0], l.bmax[1], l.bmax[2]));
+			box.Grow(Aabb(glm::vec3(r.bmin[0], r.bmin[1], r.bmin[2]), glm::vec3(r.bmax[0], r.bmax[1], r.bmax[2])));
+		}
+		for (int k = 0; k < 3; k++) {
+			n.bmin[k] = box.bmin[k];
+			n.bmax[k] = box.bmax[k];
+		}
+	}
+}
+
+std::vector<uint32_t> Bvh::Parents(const std::vector<BvhNode>& nodes) {
+	std::vector<uint32_t> parents(nodes.size(), 0);
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].count == 0) {
+			parents[i + 1] = i;
+			parents[nodes[i].offset] = i;
+		}
+	}
+	return parents;
+}
+
+bool Bvh::Validate(const std::vector<BvhNode>& nodes, const std::vector<Shape>& shapes) {
+	if (nodes.empty()) {
+		return shapes.empty();
+	}
+
+	auto box_of = [](const BvhNode& n) {
+		return Aabb(glm::vec3(n.bmin[0], n.bmin[1], n.bmin[2]), glm::vec3(n.bmax[0], n.bmax[1], n.bmax[2]));
+	};
+	auto inside = [](const Aabb& inner, const Aabb& outer) {
+		const float eps = 1e-4f;
+		return glm::all(glm::greaterThanEqual(inner.bmin, outer.bmin - eps)) && glm::all(glm::lessThanEqual(inner.bmax, outer.bmax + eps));
+	};
+
+	std::vector<int> refs(shapes.size(), 0);
+	std::vector<uint32_t> stack = { 0 };
+	size_t visited = 0;
+	while (!stack.empty()) {
+		uint32_t index = stack.back();
+		stack.pop_back();
+		if (index >= nodes.size()) {
+			return false;
+		}
+		visited++;
+		const BvhNode& n = nodes[index];
+		Aabb box = box_of(n);
+		if (n.count > 0) {
+			if ((size_t)n.offset + n.count > shapes.size()) {
+				return false;
+			}
+			for (uint32_t i = n.offset; i < n.offset + n.count; i++) {
+				refs[i]++;
+				if (!inside(ShapeBounds(shapes[i]), box)) {
+					return false;
+				}
+			}
+		} else {
+			uint32_t left = index + 1;
+			uint32_t right = n.offset;
+			if (right <= left || right >= nodes.size()) {
+				return false;
+			}
+			if (!inside(box_of(nodes[left]), box) || !inside(box_of(nodes[right]), box)) {
+				return false;
+			}
+			stack.push_back(right);
+			stack.push_back(left);
+		}
+	}
+
+	for (int r : refs) {
+		if (r != 1) {
+			return false;
+		}
+	}
+	return visited == nodes.size();
+}
+
+float Bvh::Cost(const std::vector<BvhNode>& nodes) {
+	if (nodes.empty()) {
+		return 0.0f;
+	}
+	float cost = 0.0f;
+	for (const BvhNode& n : nodes) {
+		cost += NodeCost(n);
+	}
+	return cost / std::max(Area(nodes[0]), 1e-12f);
+}
+
+float Bvh::NodeCost(const BvhNode& n) {
+	return Area(n) * ((n.count > 0) ? INTERSECT_COST * n.count : TRAVERSAL_COST);
+}
+
+float Bvh::Area(const BvhNode& n) {
+	return Aabb(glm::vec3(n.bmin[0], n.bmin[1], n.bmin[2]), glm::vec3(n.bmax[0], n.bmax[1], n.bmax[2])).Area();
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "ShaderStructs.h"
+
+struct Aabb {
+	glm::vec3 bmin;
+	glm::vec3 bmax;
+
+	Aabb() : bmin(glm::vec3(1e30f)), bmax(glm::vec3(-1e30f)) {
+	}
+
+	Aabb(const glm::vec3& lo, const glm::vec3& hi) : bmin(lo), bmax(hi) {
+	}
+
+	void Grow(const glm::vec3& p) {
+		bmin = glm::min(bmin, p);
+		bmax = glm::max(bmax, p);
+	}
+
+	void Grow(const Aabb& b) {
+		bmin = glm::min(bmin, b.bmin);
+		bmax = glm::max(bmax, b.bmax);
+	}
+
+	bool Empty() const {
+		return bmin.x > bmax.x;
+	}
+
+	glm::vec3 Center() const {
+		return (bmin + bmax) * 0.5f;
+	}
+
+	float Area() const {
+		if (Empty()) return 0.0f;
+		glm::vec3 d = bmax - bmin;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+};
+
+/*
+ * Flattened BVH node, laid out for std430 (matches BvhNode in raycompute.comp).
+ * Nodes are stored depth first: an interior node's left child is the next node
+ * and `offset` holds the right child. A leaf has count > 0 and covers the
+ * primitives [offset, offset + count).
+ */
+struct BvhNode {
+	float bmin[3];
+	uint32_t offset;
+	float bmax[3];
+	uint32_t count;
+};
+
+namespace Bvh {
+	const int BINS = 16;
+	const int MAX_LEAF = 4;
+	// Deepest path a builder may emit; the shader's traversal stack is sized to match.
+	// The GPU LBVH can go as deep as its 30 bit keys plus the index tie breaker.
+	const int MAX_DEPTH = 64;
+
+	// World space bounds of one Shape, taking Cuboid rotation into account.
+	Aabb ShapeBounds(const Shape& s);
+
+	// Binned SAH build over arbitrary primitive bounds. `order` receives the primitive
+	// permutation so leaf ranges are contiguous once primitives are reordered by it.
+	std::vector<BvhNode> Build(const std::vector<Aabb>& bounds, std::vector<uint32_t>& order);
+
+	// Builds over the shapes and reorders them in place to match the leaves.
+	std::vector<BvhNode> Build(std::vector<Shape>& shapes);
+
+	// Stand in root for an empty tree: a point box so far out that HitAabb misses it for every ray inside TMAX.
+	BvhNode EmptyNode();
+
+	// Recomputes every box bottom-up from the shapes, keeping the topology. Children are
+	// always stored after their parent, so one backwards sweep suffices.
+	void Refit(std::vector<BvhNode>& nodes, const std::vector<Shape>& shapes);
+
+	// Parent of every node, the root points at itself.
+	std::vector<uint32_t> Parents(const std::vector<BvhNode>& nodes);
+
+	// Checks the depth first links, that every shape lies inside its leaf, that children
+	// lie inside their parents and that every shape is referenced exactly once.
+	bool Validate(const std::vector<BvhNode>& nodes, const std::vector<Shape>& shapes);
+
+	// Expected SAH cost of a built tree, for comparing trees over the same primitives.
+	float Cost(const std::vector<BvhNode>& nodes);
+
+	// One node's term of Cost(), before normalizing by the root's area.
+	float NodeCost(const BvhNode& n);
+
+	// Surface area of a node's box.
+	float Area(const BvhNode& n);
+}
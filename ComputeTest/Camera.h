@@ -4,7 +4,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "Shader.h"
+#include "FrameUniforms.h"
 
 class Camera
 {
@@ -15,16 +15,20 @@ private:
 	glm::vec3 origin;
 	float lens_radius;
 	float focal_distance;
+
+	friend class CpuTracer;
 public:
 	Camera(glm::vec3 lookFrom, glm::vec3 lookAt, glm::vec3 up, float vfov, float aspect, float aperture = 0, float focal_length = -1);
 
-	void Bind(Shader<ShaderType::COMPUTE>& shdr) {
-		shdr.use();
-		shdr.setVector("cam.origin", origin);
-		shdr.setVector("cam.lower_left", lower_left_corner);
-		shdr.setVector("cam.horz", horz);
-		shdr.setVector("cam.vert", vert);
-		shdr.setFloat("cam.lens_radius", lens_radius);
+	// Camera fields of the framebuf uniform block, Commit() the frame to publish them.
+	void Bind(FrameBlock& frame) const {
+		for (int i = 0; i < 3; i++) {
+			frame.origin[i] = origin[i];
+			frame.lower_left[i] = lower_left_corner[i];
+			frame.horz[i] = horz[i];
+			frame.vert[i] = vert[i];
+		}
+		frame.lens_radius = lens_radius;
 	}
 
 };
@@ -0,0 +1,38 @@
+#include "Convergence.h"
+
+#include <cmath>
+
+Convergence::Convergence(const std::vector<float>& reference, int width, int height) :
+	reference(reference.begin(), reference.begin() + (size_t)width * height * 4) {
+}
+
+const Convergence::Point& Convergence::Add(int samples, double seconds, const std::vector<float>& rgba) {
+	double se = 0.0;
+	double rel = 0.0;
+	size_t n = 0;
+	for (size_t i = 0; i < reference.size(); i += 4) {
+		for (size_t c = 0; c < 3; c++) {
+			const double r = reference[i + c];
+			const double d = rgba[i + c] - r;
+			se += d * d;
+			rel += d * d / (r * r + EPSILON);
+			n++;
+		}
+	}
+	points.push_back({ samples, seconds, std::sqrt(se / n), rel / n });
+	return points.back();
+}
+
+const Convergence::Point* Convergence::Reached(double relmse) const {
+	for (const Point& p : points) {
+		if (p.relmse <= relmse) return &p;
+	}
+	return nullptr;
+}
+
+void Convergence::WriteCsv(std::ostream& out) const {
+	out << "samples,seconds,rmse,relmse\n";
+	for (const Point& p : points) {
+		out << p.samples << ',' << p.seconds << ',' << p.rmse << ',' << p.relmse << '\n';
+	}
+}
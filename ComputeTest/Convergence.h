@@ -0,0 +1,44 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+/*
+ * Error of a render against a reference, by sample count and time, so samplers
+ * and kernels can be compared at equal quality instead of equal sample counts.
+ * RMSE is over all RGB values. relMSE divides each squared error by the squared
+ * reference plus EPSILON, so dark and bright regions weigh alike and the few
+ * fireflies of an unconverged image do not dominate as much.
+ */
+class Convergence
+{
+public:
+	static constexpr double EPSILON = 1e-2;
+
+	struct Point {
+		int samples;
+		double seconds;		// rendering only, not measuring
+		double rmse;
+		double relmse;
+	};
+
+	// `reference` as from Image::Read, RGBA.
+	Convergence(const std::vector<float>& reference, int width, int height);
+
+	// Measures `rgba`, same layout and size as the reference, after `samples` in `seconds`.
+	const Point& Add(int samples, double seconds, const std::vector<float>& rgba);
+
+	const std::vector<Point>& Points() const {
+		return points;
+	}
+
+	// First point at or below `relmse`, null if none got there.
+	const Point* Reached(double relmse) const;
+
+	// samples,seconds,rmse,relmse per line, with a header.
+	void WriteCsv(std::ostream& out) const;
+
+private:
+	std::vector<float> reference;
+	std::vector<Point> points;
+};
@@ -0,0 +1,523 @@
+#include "CpuTracer.h"
+#include "Scene.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+	typedef CpuTracer::Ray Ray;
+	typedef CpuTracer::Material Material;
+	typedef CpuTracer::Object Object;
+	typedef CpuTracer::HitInfo HitInfo;
+
+	// Constants, same values as raycompute.comp
+	const int MAX_DEPTH = 25;
+	const int BVH_STACK_SIZE = Bvh::MAX_DEPTH;
+	const float PI = 3.14159265f;
+
+	const uint32_t MAT_LAMBERT	 = 0x00000001u;
+	const uint32_t MAT_METAL	 = 0x00000002u;
+	const uint32_t MAT_DIELECRIC = 0x00000003u;
+
+	const uint32_t SHP_SPHERE = 0x00000001u;
+	const uint32_t SHP_CUBOID = 0x00000002u;
+	const uint32_t SHP_RECT	  = 0x00000003u;
+	const uint32_t SHP_ISOTROPIC = 0xF0000000u;
+	const uint32_t SHP_PRIMITIVE_MASK = 0x0000FFFFu;
+	const uint32_t SHP_SECONDARY_MASK = 0xFFFF0000u;
+
+	const uint32_t AXIS_X = 0x00000000u;
+	const uint32_t AXIS_Y = 0x00000001u;
+	const uint32_t AXIS_Z = 0x00000002u;
+
+	glm::uvec4 pcg4d(glm::uvec4 v) {
+		v = v * 1664525u + 1013904223u;
+		v.x += v.y*v.w; v.y += v.z*v.x; v.z += v.x*v.y; v.w += v.y*v.z;
+		v ^= v >> 16u;
+		v.x += v.y*v.w; v.y += v.z*v.x; v.z += v.x*v.y; v.w += v.y*v.z;
+		return v;
+	}
+
+	// One invocation's worth of state: where the sample is, for the rng, and the object list.
+	struct Tracer {
+		glm::uvec4 rng_key;		// pixel, sample, next dimension, seed
+		const std::vector<Object>& obj;
+		const std::vector<BvhNode>& bvh;
+		uint64_t rays;
+
+		float rng() {
+			uint32_t x = pcg4d(rng_key).x;
+			rng_key.z++;
+			return float(x >> 8) * (1.0f / 16777216.0f);
+		}
+
+		// Draws are made one statement at a time to keep the rng stream identical to the shader.
+		glm::vec3 RandomOnUnitSphere() {
+			float z = 1.0f - 2.0f*rng();
+			float phi = 2.0f*PI*rng();
+			float r = std::sqrt(glm::max(0.0f, 1.0f - z*z));
+			return glm::vec3(r*std::cos(phi), r*std::sin(phi), z);
+		}
+
+		glm::vec3 RandomInUnitSphere() {
+			glm::vec3 dir = RandomOnUnitSphere();
+			return dir * std::cbrt(rng());
+		}
+
+		glm::vec2 RandomInUnitDisk() {
+			float x = 2.0f*rng() - 1.0f;
+			float y = 2.0f*rng() - 1.0f;
+			bool x_major = std::abs(x) > std::abs(y);
+			float r = x_major ? x : y;
+			float phi = x_major ? (PI/4.0f)*(y/x) : (PI/2.0f) - (PI/4.0f)*(x/(y == 0.0f ? 1.0f : y));
+			return r * glm::vec2(std::cos(phi), std::sin(phi));
+		}
+
+		glm::vec3 RandomCosineHemisphere(const glm::vec3& n) {
+			glm::vec2 d = RandomInUnitDisk();
+			float s = (n.z >= 0.0f) ? 1.0f : -1.0f;
+			float a = -1.0f/(s + n.z);
+			float b = n.x*n.y*a;
+			glm::vec3 t(1.0f + s*n.x*n.x*a, s*b, -s*n.x);
+			glm::vec3 bt(b, s + n.y*n.y*a, -n.y);
+			return d.x*t + d.y*bt + std::sqrt(glm::max(0.0f, 1.0f - glm::dot(d, d)))*n;
+		}
+
+		static glm::vec3 custom_reflect(const glm::vec3& I, const glm::vec3& N) {
+			return (I - 2 * glm::dot(I, glm::normalize(N)) * glm::normalize(N));
+		}
+
+		glm::vec3 ScatterLambert(HitInfo& hit) {
+			hit.r.A = hit.hitpoint;
+			hit.r.B = RandomCosineHemisphere(hit.normal);
+			hit.hit = glm::dot(hit.r.B, hit.normal) > 0.0f;
+			return (hit.hit) ? hit.m.albedo : glm::vec3(0.0f);
+		}
+
+		glm::vec3 ScatterMetal(HitInfo& hit) {
+			hit.r.A = hit.hitpoint;
+			hit.r.B = glm::normalize(custom_reflect(hit.r.B, hit.normal)) + 0.2f * RandomInUnitSphere() * hit.m.param;
+			hit.hit = glm::dot(hit.r.B, hit.normal) > 0.0f;
+			return (hit.hit) ? hit.m.albedo : glm::vec3(0.0f);
+		}
+
+		static float schlick(float cosine, float ri) {
+			float r0 = (1.0f - ri) / (1.0f + ri);
+			r0 = r0*r0;
+			float anticos = (1.0f - cosine);
+			return r0 + (1.0f - r0)*anticos*anticos*anticos*anticos*anticos;
+		}
+
+		glm::vec3 refract_dielectric(const glm::vec3& v, const glm::vec3& norm, float nu, float refl_prob) {
+			glm::vec3 uv = glm::normalize(v);
+			float dt = glm::dot(uv, norm);
+			float disc = 1.0f - nu*nu*(1.0f - dt*dt);
+			if (disc > 0.0f && rng() > refl_prob) {
+				return nu*(uv - norm*dt) - norm*std::sqrt(disc);
+			} else {
+				return custom_reflect(uv, norm);
+			}
+		}
+
+		glm::vec3 ScatterDielectric(HitInfo& hit) {
+			glm::vec3 norm;
+			float nu;
+			float cosine;
+			if (glm::dot(hit.normal, hit.r.B) > 0) {
+				norm = -hit.normal;
+				nu = hit.m.param;
+				cosine = hit.m.param * glm::dot(glm::normalize(hit.r.B), hit.normal);
+			} else {
+				norm = hit.normal;
+				nu = 1.0f / hit.m.param;
+				cosine = -glm::dot(glm::normalize(hit.r.B), hit.normal);
+			}
+
+			float ref_prob = schlick(cosine, hit.m.param);
+
+			hit.r.A = hit.hitpoint;
+			hit.r.B = refract_dielectric(hit.r.B, norm, nu, ref_prob);
+
+			return hit.m.albedo;
+		}
+
+		glm::vec3 ScatterIso(HitInfo& hit) {
+			rng();	// The shader draws and discards one sample here.
+
+			hit.r.A = hit.hitpoint;
+			hit.r.B = RandomOnUnitSphere();
+			hit.hit = true;
+			return hit.m.albedo;
+		}
+
+		glm::vec3 Scatter(HitInfo& hit) {
+			if (hit.m.type == MAT_LAMBERT) {
+				return ScatterLambert(hit);
+			} else if (hit.m.type == MAT_METAL) {
+				return ScatterMetal(hit);
+			} else if (hit.m.type == MAT_DIELECRIC) {
+				return ScatterDielectric(hit);
+			} else {
+				return ScatterIso(hit);
+			}
+		}
+
+		HitInfo HitSphere(const Object& s, const Ray& r, float tmin) {
+			glm::vec3 oc = r.A - s.A;
+			float a = glm::dot(r.B, r.B);
+			float b = 2.0f * glm::dot(oc, r.B);
+			float c = glm::dot(oc, oc) - s.B.x*s.B.x;
+			float disc = b*b - 4*a*c;
+			HitInfo h = {};
+			h.hit = (disc > 0.0f);
+			if (!h.hit) {
+				return h;
+			}
+			h.t = (-b - std::sqrt(disc)) / (2.0f*a);
+			float t2 = (-b + std::sqrt(disc)) / (2.0f*a);
+			if (h.t < tmin) {
+				h.t = t2;
+				if (h.t < tmin) {
+					h.hit = false;
+					return h;
+				}
+			}
+
+			if ((s.type & SHP_SECONDARY_MASK) == SHP_ISOTROPIC) {
+				float d = std::abs(t2 - h.t) * glm::length(r.B);
+				float hit_d = -(1.0f / s.density)*std::log(rng());
+				if (hit_d < d) {
+					h.t = h.t + (hit_d / glm::length(r.B));
+					h.hitpoint = r.A + h.t*r.B;
+				} else {
+					h.hit = false;
+				}
+			} else {
+				h.hitpoint = r.A + h.t * r.B;
+				h.normal = (h.hitpoint - s.A) / s.B.x;
+			}
+			return h;
+		}
+
+		static HitInfo HitRectXY(float sAx, float sAy, float sBx, float sBy, float z, const Ray& r, float normal) {
+			HitInfo h = {};
+			float t = (z - r.A.z) / r.B.z;
+			float x = r.A.x + r.B.x * t;
+			float y = r.A.y + r.B.y * t;
+
+			if (x < sAx || x > sBx + sAx || y < sAy || y > sBy + sAy) {
+				h.hit = false;
+				h.t = t;
+				return h;
+			}
+
+			h.hit = true;
+			h.hitpoint = r.A + t*r.B;
+			h.normal = glm::vec3(0, 0, normal);
+			h.t = t;
+			return h;
+		}
+
+		static HitInfo HitRectYZ(float sAy, float sAz, float sBy, float sBz, float x, const Ray& r, float normal) {
+			HitInfo h = {};
+			float t = (x - r.A.x) / r.B.x;
+			float z = r.A.z + r.B.z * t;
+			float y = r.A.y + r.B.y * t;
+
+			if (z < sAz || z > sBz + sAz || y < sAy || y > sBy + sAy) {
+				h.hit = false;
+				h.t = t;
+				return h;
+			}
+
+			h.hit = true;
+			h.hitpoint = r.A + t*r.B;
+			h.normal = glm::vec3(normal, 0, 0);
+			h.t = t;
+			return h;
+		}
+
+		static HitInfo HitRectXZ(float sAx, float sAz, float sBx, float sBz, float y, const Ray& r, float normal) {
+			HitInfo h = {};
+			float t = (y - r.A.y) / r.B.y;
+			float z = r.A.z + r.B.z * t;
+			float x = r.A.x + r.B.x * t;
+
+			if (z < sAz || z > sBz + sAz || x < sAx || x > sBx + sAx) {
+				h.hit = false;
+				h.t = t;
+				return h;
+			}
+
+			h.hit = true;
+			h.hitpoint = r.A + t*r.B;
+			h.normal = glm::vec3(0, normal, 0);
+			h.t = t;
+			return h;
+		}
+
+		static glm::vec3 rotateXZ(const glm::vec3& a, float angle) {
+			return glm::vec3(std::cos(angle)*a.x - std::sin(angle)*a.z, a.y, std::sin(angle)*a.x + std::cos(angle)*a.z);
+		}
+
+		HitInfo HitCuboid(const Object& s, Ray r, float tmin) {
+			float theta = s.param / 1000.0f;
+			glm::vec3 center = (s.A + s.B)*0.5f;
+			glm::vec3 A = center + rotateXZ(r.A - center, -theta);
+			glm::vec3 B = center + rotateXZ(r.B + r.A - center, -theta) - A;
+
+			r = Ray{ A, B };
+			HitInfo h;
+			HitInfo hmin;
+			HitInfo hmax;
+			h = HitRectXY(s.A.x, s.A.y, s.B.x, s.B.y, s.A.z, r, -1);
+			hmin = h;
+			hmax = h;
+			h = HitRectXY(s.A.x, s.A.y, s.B.x, s.B.y, s.A.z + s.B.z, r, 1);
+			if (h.hit && h.t < hmin.t) hmin = h;
+			if (h.hit && h.t > hmax.t) hmax = h;
+			h = HitRectYZ(s.A.y, s.A.z, s.B.y, s.B.z, s.A.x, r, -1);
+			if (h.hit && h.t < hmin.t) hmin = h;
+			if (h.hit && h.t > hmax.t) hmax = h;
+			h = HitRectYZ(s.A.y, s.A.z, s.B.y, s.B.z, s.A.x + s.B.x, r, 1);
+			if (h.hit && h.t < hmin.t) hmin = h;
+			if (h.hit && h.t > hmax.t) hmax = h;
+			h = HitRectXZ(s.A.x, s.A.z, s.B.x, s.B.z, s.A.y, r, -1);
+			if (h.hit && h.t < hmin.t) hmin = h;
+			if (h.hit && h.t > hmax.t) hmax = h;
+			h = HitRectXZ(s.A.x, s.A.z, s.B.x, s.B.z, s.A.y + s.B.y, r, 1);
+			if (h.hit && h.t < hmin.t) hmin = h;
+			if (h.hit && h.t > hmax.t) hmax = h;
+
+			h = hmin;
+			if (hmin.t < tmin) {
+				hmin = hmax;
+				hmax = h;
+			}
+			if (hmin.t < tmin) {
+				hmin.hit = false;
+				return hmin;
+			}
+
+			if ((s.type & SHP_SECONDARY_MASK) == SHP_ISOTROPIC) {
+				float d = std::abs(hmax.t - hmin.t) * glm::length(r.B);
+				float hit_d = -(1.0f / s.density)*std::log(rng());
+				if (hit_d < d) {
+					hmin.t = hmin.t + (hit_d / glm::length(r.B));
+					hmin.hitpoint = r.A + hmin.t*r.B;
+				} else {
+					hmin.hit = false;
+				}
+			} else {
+				hmin.normal = rotateXZ(hmin.normal, theta);
+				hmin.hitpoint = center + rotateXZ(hmin.hitpoint - center, theta);
+			}
+
+			return hmin;
+		}
+
+		static float sign(float x) {
+			return (x > 0.0f) ? 1.0f : ((x < 0.0f) ? -1.0f : 0.0f);
+		}
+
+		HitInfo HitShape(const Object& s, const Ray& r, float tmin) {
+			switch (s.type & SHP_PRIMITIVE_MASK) {
+			case SHP_SPHERE: {
+				return HitSphere(s, r, tmin);
+			}; break;
+			case SHP_CUBOID: {
+				return HitCuboid(s, r, tmin);
+			}; break;
+			case SHP_RECT: {
+				HitInfo h = {};
+				switch (s.param) {
+				case AXIS_X: {
+					h = HitRectYZ(s.A.y, s.A.z, s.B.y, s.B.z, s.A.x, r, sign(s.B.x));
+					if (h.t < tmin) h.hit = false;
+				}; break;
+				case AXIS_Y: {
+					h = HitRectXZ(s.A.x, s.A.z, s.B.x, s.B.z, s.A.y, r, sign(s.B.y));
+					if (h.t < tmin) h.hit = false;
+				}; break;
+				case AXIS_Z: {
+					h = HitRectXY(s.A.x, s.A.y, s.B.x, s.B.y, s.A.z, r, sign(s.B.z));
+					if (h.t < tmin) h.hit = false;
+				}; break;
+				}
+				return h;
+			}; break;
+			default: {
+				return HitSphere(s, r, tmin);
+			}; break;
+			}
+		}
+
+		static float HitAabb(const BvhNode& n, const glm::vec3& origin, const glm::vec3& inv_dir, float tmin, float tmax) {
+			glm::vec3 t0 = (glm::vec3(n.bmin[0], n.bmin[1], n.bmin[2]) - origin) * inv_dir;
+			glm::vec3 t1 = (glm::vec3(n.bmax[0], n.bmax[1], n.bmax[2]) - origin) * inv_dir;
+			glm::vec3 tsmall = glm::min(t0, t1);
+			glm::vec3 tbig = glm::max(t0, t1);
+			float tnear = glm::max(glm::max(tsmall.x, tsmall.y), glm::max(tsmall.z, tmin));
+			float tfar = glm::min(glm::min(tbig.x, tbig.y), glm::min(tbig.z, tmax));
+			return (tnear <= tfar) ? tnear : -1.0f;
+		}
+
+		HitInfo WorldHit(const Ray& r, float tmin, float tmax) {
+			rays++;
+			HitInfo hmin = {};
+			hmin.hit = false;
+			hmin.t = tmax;
+			hmin.r = r;
+			if (bvh.empty()) {
+				return hmin;
+			}
+
+			glm::vec3 inv_dir = 1.0f / r.B;
+			if (HitAabb(bvh[0], r.A, inv_dir, tmin, hmin.t) < 0.0f) {
+				return hmin;
+			}
+
+			uint32_t stack[BVH_STACK_SIZE];
+			int sp = 0;
+			uint32_t index = 0;
+			while (true) {
+				const BvhNode& node = bvh[index];
+				if (node.count > 0) {
+					for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+						HitInfo h = HitShape(obj[i], r, tmin);
+						if (h.hit) {
+							if (hmin.t > h.t) {
+								hmin = h;
+								hmin.m = obj[i].M;
+							}
+						}
+					}
+				} else {
+					uint32_t left = index + 1;
+					uint32_t right = node.offset;
+					float tl = HitAabb(bvh[left], r.A, inv_dir, tmin, hmin.t);
+					float tr = HitAabb(bvh[right], r.A, inv_dir, tmin, hmin.t);
+					if (tl >= 0.0f && tr >= 0.0f) {
+						index = (tl <= tr) ? left : right;
+						stack[sp++] = (tl <= tr) ? right : left;
+						continue;
+					} else if (tl >= 0.0f) {
+						index = left;
+						continue;
+					} else if (tr >= 0.0f) {
+						index = right;
+						continue;
+					}
+				}
+				if (sp == 0) break;
+				index = stack[--sp];
+			}
+			hmin.r = r;
+			return hmin;
+		}
+
+		glm::vec4 Color(Ray r) {
+			glm::vec3 A = glm::vec3(0);
+			glm::vec3 M = glm::vec3(1);
+			for (int depth = 0; depth < MAX_DEPTH; depth++) {
+				HitInfo h = WorldHit(r, 0.001f, 1000.0f);
+				if (h.hit) {
+					A = A + M * h.m.emissive;
+					M = M * Scatter(h);
+					if (!h.hit) break;
+					r = h.r;
+				}
+				else {
+					// No skybox on the CPU, same as skybox_active == false.
+					M = M * glm::vec3(0.0f);
+					break;
+				}
+			}
+			return glm::vec4(A + M, 1.0f);
+		}
+	};
+}
+
+CpuTracer::CpuTracer(const std::vector<Shape>& shapes, const Camera& cam, int width, int height, int threads, uint32_t seed) :
+	image(width * height, glm::vec4(0.0f)),
+	pool(threads),
+	lower_left(cam.lower_left_corner),
+	horz(cam.horz),
+	vert(cam.vert),
+	origin(cam.origin),
+	lens_radius(cam.lens_radius),
+	width(width),
+	height(height),
+	iteration(0),
+	seed(seed) {
+
+	counters = std::vector<RayCounter>(pool.Size(), RayCounter{ 0 });
+
+	std::vector<Shape> sorted = shapes;
+	bvh = Bvh::Build(sorted);
+
+	// Same reinterpretation of the 80 byte Shape that the std430 objbuf layout applies.
+	for (const Shape& s : sorted) {
+		Object o;
+		o.A = glm::vec3(s.A[0], s.A[1], s.A[2]);
+		o.type = s.shape_type;
+		o.B = glm::vec3(s.B[0], s.B[1], s.B[2]);
+		std::memcpy(&o.param, &s.rotation, sizeof(uint32_t));
+		o.density = s.density;
+		o.M.albedo = glm::vec3(s.C[0], s.C[1], s.C[2]);
+		o.M.param = s.param;
+		o.M.emissive = glm::vec3(s.D[0], s.D[1], s.D[2]);
+		o.M.type = s.mat_type;
+		objects.push_back(o);
+	}
+}
+
+void CpuTracer::RenderTile(int tile, int worker, int samples) {
+	const int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int x0 = (tile % tiles_x) * TILE_SIZE;
+	const int y0 = (tile / tiles_x) * TILE_SIZE;
+	const int x1 = glm::min(x0 + TILE_SIZE, width);
+	const int y1 = glm::min(y0 + TILE_SIZE, height);
+
+	Tracer tr = { glm::uvec4(0u, 0u, 0u, seed), objects, bvh, 0u };
+	for (int j = y0; j < y1; j++) {
+		for (int i = x0; i < x1; i++) {
+			const int index = j * width + i;
+			glm::vec4 img = image[index];
+			for (int s = 0; s < samples; s++) {
+				const int it = iteration + s;
+				tr.rng_key = glm::uvec4(index, it, 0u, seed);
+				float x = (i + tr.rng()) / float(width);
+				float y = (j + tr.rng()) / float(height);
+
+				// GetRay
+				glm::vec2 rd = lens_radius * tr.RandomInUnitDisk();
+				glm::vec3 offset = glm::normalize(horz) * rd.x + glm::normalize(vert) * rd.y;
+				Ray r = { origin + offset, (lower_left + x*horz + y*vert - offset - origin) };
+
+				img = (tr.Color(r) + float(it) * img)*(1.0f / (1.0f + it));
+			}
+			image[index] = img;
+		}
+	}
+	counters[worker].rays += tr.rays;
+}
+
+void CpuTracer::Render(int samples) {
+	const int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+	pool.Run(tiles_x * tiles_y, [this, samples](int tile, int worker) {
+		RenderTile(tile, worker, samples);
+	});
+	iteration += samples;
+}
+
+std::vector<CpuTracer::ThreadStats> CpuTracer::Stats() const {
+	std::vector<WorkStealingPool::WorkerStats> pool_stats = pool.Stats();
+	std::vector<ThreadStats> stats;
+	for (size_t i = 0; i < pool_stats.size(); i++) {
+		stats.push_back({ counters[i].rays, pool_stats[i].tasks, pool_stats[i].steals, pool_stats[i].busy_seconds });
+	}
+	return stats;
+}
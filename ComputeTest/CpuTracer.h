@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "ShaderStructs.h"
+#include "Camera.h"
+#include "WorkStealingPool.h"
+#include "Bvh.h"
+
+/*
+ * CPU port of raycompute.comp.
+ * Traces the same std::vector<Shape> the shader reads from objbuf, with the same
+ * random numbers as its random sampler and the same accumulation rule, so its output can be
+ * held against the GPU image to validate kernel changes. The BVH comes from the
+ * same builder as the GPU path, so both traverse identical trees. Tiles are spread
+ * over a work stealing pool so it also serves as a fallback on nodes without a GPU.
+ */
+class CpuTracer
+{
+public:
+	struct ThreadStats {
+		uint64_t rays;
+		uint64_t tiles;
+		uint64_t steals;
+		double busy_seconds;
+	};
+
+	static const int TILE_SIZE = 16;
+
+	// Mirrors of the shader side structs.
+	struct Ray {
+		glm::vec3 A;
+		glm::vec3 B;
+	};
+
+	struct Material {
+		glm::vec3 albedo;
+		float param;
+		glm::vec3 emissive;
+		uint32_t type;
+	};
+
+	struct Object {
+		glm::vec3 A;
+		uint32_t type;
+		glm::vec3 B;
+		uint32_t param;
+		float density;
+		Material M;
+	};
+
+	struct HitInfo {
+		bool hit;
+		glm::vec3 hitpoint;
+		float t;
+		glm::vec3 normal;
+		Ray r;
+		Material m;
+	};
+
+private:
+	struct alignas(64) RayCounter {
+		uint64_t rays;
+	};
+
+	std::vector<Object> objects;
+	std::vector<BvhNode> bvh;
+	std::vector<glm::vec4> image;
+	std::vector<RayCounter> counters;
+	WorkStealingPool pool;
+
+	glm::vec3 lower_left;
+	glm::vec3 horz;
+	glm::vec3 vert;
+	glm::vec3 origin;
+	float lens_radius;
+
+	int width;
+	int height;
+	int iteration;
+	uint32_t seed;
+
+	void RenderTile(int tile, int worker, int samples);
+
+public:
+	// threads <= 0 uses every hardware thread. `seed` is TracerHeadless --seed.
+	CpuTracer(const std::vector<Shape>& shapes, const Camera& cam, int width, int height, int threads = 0, uint32_t seed = 1);
+
+	// Accumulates `samples` more samples into every pixel.
+	void Render(int samples);
+
+	// RGBA, bottom row first like the GL output texture.
+	const std::vector<glm::vec4>& Image() const {
+		return image;
+	}
+
+	int Iteration() const {
+		return iteration;
+	}
+
+	int Threads() const {
+		return pool.Size();
+	}
+
+	std::vector<ThreadStats> Stats() const;
+};
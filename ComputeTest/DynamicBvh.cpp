@@ -0,0 +1,151 @@
+#include "DynamicBvh.h"
+
+#include <algorithm>
+
+DynamicBvh::DynamicBvh(const std::vector<Shape>& shapes, float rebuild_ratio) :
+	shapes(shapes),
+	slot(shapes.size()),
+	cost_sum(0.0),
+	build_cost(0.0f),
+	cost(0.0f),
+	rebuild_ratio(rebuild_ratio),
+	rebuilds(0),
+	stale(false),
+	committed(false) {
+
+	for (uint32_t i = 0; i < slot.size(); i++) {
+		slot[i] = i;
+	}
+	Rebuild();
+	rebuilds = 0;
+}
+
+void DynamicBvh::Rebuild() {
+	std::vector<Aabb> bounds;
+	bounds.reserve(shapes.size());
+	for (const Shape& s : shapes) {
+		bounds.push_back(Bvh::ShapeBounds(s));
+	}
+
+	// `order` maps new positions to old ones, follow it for the shapes and invert it for the slots.
+	std::vector<uint32_t> order;
+	nodes = Bvh::Build(bounds, order);
+	std::vector<Shape> sorted;
+	sorted.reserve(shapes.size());
+	std::vector<uint32_t> moved(shapes.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		sorted.push_back(shapes[order[i]]);
+		moved[order[i]] = i;
+	}
+	shapes.swap(sorted);
+	for (uint32_t& s : slot) {
+		s = moved[s];
+	}
+	for (uint32_t& d : dirty) {
+		d = moved[d];
+	}
+
+	parents = Bvh::Parents(nodes);
+	leaf_of.assign(shapes.size(), 0);
+	for (uint32_t i = 0; i < nodes.size(); i++) {
+		for (uint32_t p = nodes[i].offset; p < nodes[i].offset + nodes[i].count; p++) {
+			leaf_of[p] = i;
+		}
+	}
+	marked.assign(nodes.size(), 0);
+
+	cost_sum = 0.0;
+	for (const BvhNode& n : nodes) {
+		cost_sum += Bvh::NodeCost(n);
+	}
+	build_cost = Bvh::Cost(nodes);
+	cost = build_cost;
+	stale = false;
+	rebuilds++;
+}
+
+DynamicBvh::Result DynamicBvh::Check() {
+	if (cost > build_cost * rebuild_ratio) {
+		Rebuild();
+		return Result::REBUILT;
+	}
+	return Result::REFIT;
+}
+
+void DynamicBvh::Update(uint32_t index, const Shape& s) {
+	if (committed) {
+		dirty.clear();
+		committed = false;
+	}
+	uint32_t p = slot[index];
+	shapes[p] = s;
+	dirty.push_back(p);
+}
+
+DynamicBvh::Result DynamicBvh::Commit() {
+	if (committed || dirty.empty()) {
+		return Result::NONE;
+	}
+	committed = true;
+
+	// Once a good share of the shapes moved, the paths cover most of the tree anyway.
+	if (stale || dirty.size() * 4 > shapes.size()) {
+		Bvh::Refit(nodes, shapes);
+		cost_sum = 0.0;
+		for (const BvhNode& n : nodes) {
+			cost_sum += Bvh::NodeCost(n);
+		}
+		stale = false;
+	} else {
+		// Mark every node on a changed path, then sweep them backwards so children come first.
+		std::vector<uint32_t> path;
+		for (uint32_t p : dirty) {
+			uint32_t node = leaf_of[p];
+			while (!marked[node]) {
+				marked[node] = 1;
+				path.push_back(node);
+				if (node == 0) break;
+				node = parents[node];
+			}
+		}
+		std::sort(path.begin(), path.end());
+		for (auto it = path.rbegin(); it != path.rend(); ++it) {
+			BvhNode& n = nodes[*it];
+			cost_sum -= Bvh::NodeCost(n);
+			Aabb box;
+			if (n.count > 0) {
+				for (uint32_t p = n.offset; p < n.offset + n.count; p++) {
+					box.Grow(Bvh::ShapeBounds(shapes[p]));
+				}
+			} else {
+				for (uint32_t c : { *it + 1, n.offset }) {
+					box.Grow(Aabb(glm::vec3(nodes[c].bmin[0], nodes[c].bmin[1], nodes[c].bmin[2]),
+						glm::vec3(nodes[c].bmax[0], nodes[c].bmax[1], nodes[c].bmax[2])));
+				}
+			}
+			for (int k = 0; k < 3; k++) {
+				n.bmin[k] = box.bmin[k];
+				n.bmax[k] = box.bmax[k];
+			}
+			cost_sum += Bvh::NodeCost(n);
+			marked[*it] = 0;
+		}
+	}
+
+	// Only the touched nodes' terms changed, keep the sum instead of walking the whole tree.
+	cost = nodes.empty() ? 0.0f : (float)(cost_sum / std::max(Bvh::Area(nodes[0]), 1e-12f));
+	return Check();
+}
+
+DynamicBvh::Result DynamicBvh::Commit(float measured_cost) {
+	if (committed || dirty.empty()) {
+		return Result::NONE;
+	}
+	committed = true;
+	stale = true;
+	if (measured_cost < 0.0f) {
+		return Result::REFIT;
+	}
+	cost = measured_cost;
+	return Check();
+}
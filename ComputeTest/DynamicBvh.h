@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Bvh.h"
+
+/*
+ * SAH BVH over shapes that move but never appear or disappear, e.g. a rotating
+ * Cuboid or a Sphere sliding around. Changed shapes only refit the boxes on their
+ * path to the root; the topology is kept until the tree's SAH cost has degraded
+ * past `rebuild_ratio` times the cost right after the last build, then it is
+ * rebuilt from scratch.
+ *
+ * Shapes are addressed by their index in the vector given to the constructor.
+ * Shapes() and Nodes() are in leaf order, ready for objbuf and bvhbuf.
+ */
+class DynamicBvh
+{
+public:
+	enum class Result {
+		NONE,		// nothing changed
+		REFIT,		// boxes changed, upload Nodes() and the changed Shapes()
+		REBUILT		// topology and shape order changed, upload everything
+	};
+
+private:
+	std::vector<Shape> shapes;			// leaf order
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> slot;			// caller index -> position in shapes
+	std::vector<uint32_t> parents;		// node -> parent, root points at itself
+	std::vector<uint32_t> leaf_of;		// position in shapes -> leaf node
+	std::vector<uint32_t> dirty;		// positions changed since the last commit
+	std::vector<uint8_t> marked;		// scratch for Commit()
+	double cost_sum;					// running sum of Bvh::NodeCost over all nodes
+	float build_cost;
+	float cost;
+	float rebuild_ratio;
+	uint32_t rebuilds;
+	bool stale;							// boxes were last refitted on the device
+	bool committed;						// the next Update() starts a new dirty list
+
+	void Rebuild();
+	Result Check();
+
+public:
+	explicit DynamicBvh(const std::vector<Shape>& shapes, float rebuild_ratio = 1.3f);
+
+	// Replaces shape `index` (caller order). Boxes follow at the next Commit().
+	void Update(uint32_t index, const Shape& s);
+
+	// Refits the paths from every updated shape to the root on the CPU, then rebuilds
+	// if the cost has degraded too far.
+	Result Commit();
+
+	// Same, for boxes already refitted on the device by GpuBvhRefitter: only the quality check
+	// runs, on the cost it measured. A negative cost skips the check for frames that did not
+	// measure. Nodes() is out of date unless this returns REBUILT.
+	Result Commit(float measured_cost);
+
+	const std::vector<Shape>& Shapes() const {
+		return shapes;
+	}
+
+	const std::vector<BvhNode>& Nodes() const {
+		return nodes;
+	}
+
+	// Position of caller shape `index` inside Shapes().
+	uint32_t Slot(uint32_t index) const {
+		return slot[index];
+	}
+
+	// Positions updated for the current or, after Commit(), the last commit. For partial uploads.
+	const std::vector<uint32_t>& Dirty() const {
+		return dirty;
+	}
+
+	float Cost() const {
+		return cost;
+	}
+
+	float BuildCost() const {
+		return build_cost;
+	}
+
+	uint32_t Rebuilds() const {
+		return rebuilds;
+	}
+};
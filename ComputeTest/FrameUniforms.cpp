@@ -0,0 +1,64 @@
+#include "FrameUniforms.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+	const int SEGMENTS = 4;
+	const int SEGMENT_SLOTS = FrameUniforms::SLOTS / SEGMENTS;
+}
+
+FrameUniforms::FrameUniforms() :
+	block(),
+	buffer(0),
+	mapped(nullptr),
+	next(0),
+	fences() {
+
+	GLint align = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	stride = ((GLsizeiptr)sizeof(FrameBlock) + align - 1) / align * align;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferStorage(GL_UNIFORM_BUFFER, stride * SLOTS, nullptr, flags);
+	mapped = (uint8_t*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, stride * SLOTS, flags);
+	if (!mapped) {
+		std::cout << "ERR::FRAME_UNIFORMS::MAP_FAILED" << std::endl;
+	}
+}
+
+FrameUniforms::~FrameUniforms() {
+	for (GLsync fence : fences) {
+		if (fence) glDeleteSync(fence);
+	}
+	// Deleting the buffer also unmaps it.
+	glDeleteBuffers(1, &buffer);
+}
+
+void FrameUniforms::Commit() {
+	if (!mapped) return;
+
+	// Entering a segment: every dispatch that reads the segment we just left has
+	// been issued by now, so fence it, then wait until the GPU is done with the
+	// last round of slots in the one we are entering.
+	const int segment = next / SEGMENT_SLOTS;
+	if (next % SEGMENT_SLOTS == 0) {
+		const int previous = (segment + SEGMENTS - 1) % SEGMENTS;
+		if (fences[previous]) glDeleteSync(fences[previous]);
+		fences[previous] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		if (fences[segment]) {
+			glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fences[segment]);
+			fences[segment] = 0;
+		}
+	}
+
+	std::memcpy(mapped + next * stride, &block, sizeof(FrameBlock));
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer, next * stride, sizeof(FrameBlock));
+
+	next = (next + 1) % SLOTS;
+}
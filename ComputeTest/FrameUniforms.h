@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+// std140 image of the framebuf uniform block in raycompute.comp.
+struct FrameBlock {
+	float lower_left[3];
+	float __padd0;
+	float horz[3];
+	float __padd1;
+	float vert[3];
+	float __padd2;
+	float origin[3];
+	float lens_radius;
+	int32_t chunk[2];
+	int32_t chunk_size[2];
+	int32_t iteration;
+	float time;
+	int32_t n_instances;
+	uint32_t skybox_active;
+	uint32_t seed;
+	uint32_t __padd3[3];
+
+	void SetChunk(const glm::ivec2& offset, const glm::ivec2& size) {
+		chunk[0] = offset.x;
+		chunk[1] = offset.y;
+		chunk_size[0] = size.x;
+		chunk_size[1] = size.y;
+	}
+};
+static_assert(sizeof(FrameBlock) == 112, "FrameBlock must match the std140 layout of framebuf");
+
+/*
+ * Camera and per dispatch state for raycompute.comp as one uniform buffer, so a
+ * dispatch costs a memcpy and a glBindBufferRange instead of a handful of
+ * glUniform calls by name on every program. The buffer is persistently mapped
+ * and used as a ring: each Commit() writes the next slot, and a fence per
+ * quarter of the ring keeps the CPU from overwriting slots still in flight.
+ */
+class FrameUniforms
+{
+private:
+	FrameBlock block;
+	GLuint buffer;
+	uint8_t* mapped;
+	GLsizeiptr stride;
+	int next;
+	GLsync fences[4];
+
+public:
+	static const GLuint BINDING = 0;
+	static const int SLOTS = 256;
+
+	FrameUniforms();
+	~FrameUniforms();
+
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	// Staging copy, edit it and Commit().
+	FrameBlock& Block() {
+		return block;
+	}
+
+	// Publishes the staging copy to the next ring slot and binds it to BINDING.
+	void Commit();
+};
@@ -0,0 +1,186 @@
+#include "GpuBvhBuilder.h"
+
+namespace {
+
+	const int SAVED_BINDINGS = 8;
+
+	struct SavedBinding {
+		GLint buffer;
+		GLint64 start;
+		GLint64 size;
+	};
+
+	GLuint Groups(GLuint n) {
+		return (n + GpuBvhBuilder::BLOCK - 1) / GpuBvhBuilder::BLOCK;
+	}
+
+	void Resize(GLuint buffer, GLsizeiptr bytes) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_DYNAMIC_COPY);
+	}
+}
+
+GpuBvhBuilder::GpuBvhBuilder() :
+	bounds("lbvh_bounds.comp"),
+	morton("lbvh_morton.comp"),
+	histogram("radix_histogram.comp"),
+	scan("radix_scan.comp"),
+	scatter("radix_scatter.comp"),
+	hierarchy("lbvh_hierarchy.comp"),
+	fit("lbvh_fit.comp"),
+	flatten("lbvh_flatten.comp"),
+	capacity(0) {
+
+	glGenBuffers(1, &prim_bounds);
+	glGenBuffers(1, &scene_bounds);
+	glGenBuffers(2, keys);
+	glGenBuffers(2, vals);
+	glGenBuffers(1, &hist);
+	glGenBuffers(1, &internal);
+	glGenBuffers(1, &parents);
+	glGenBuffers(1, &visits);
+	glGenBuffers(1, &node_bounds);
+
+	Resize(scene_bounds, 6 * sizeof(GLuint));
+}
+
+GpuBvhBuilder::~GpuBvhBuilder() {
+	glDeleteBuffers(1, &prim_bounds);
+	glDeleteBuffers(1, &scene_bounds);
+	glDeleteBuffers(2, keys);
+	glDeleteBuffers(2, vals);
+	glDeleteBuffers(1, &hist);
+	glDeleteBuffers(1, &internal);
+	glDeleteBuffers(1, &parents);
+	glDeleteBuffers(1, &visits);
+	glDeleteBuffers(1, &node_bounds);
+}
+
+void GpuBvhBuilder::Reserve(GLuint n_prims) {
+	if (n_prims <= capacity) {
+		return;
+	}
+	GLuint n_nodes = 2 * n_prims - 1;
+	Resize(prim_bounds, n_prims * 2 * sizeof(glm::vec4));
+	for (int k = 0; k < 2; k++) {
+		Resize(keys[k], n_prims * sizeof(GLuint));
+		Resize(vals[k], n_prims * sizeof(GLuint));
+	}
+	Resize(hist, 16 * Groups(n_prims) * sizeof(GLuint));
+	Resize(internal, n_prims * sizeof(glm::uvec4));
+	Resize(parents, n_nodes * sizeof(GLuint));
+	Resize(visits, n_prims * sizeof(GLuint));
+	Resize(node_bounds, n_nodes * 2 * sizeof(glm::vec4));
+	capacity = n_prims;
+}
+
+void GpuBvhBuilder::Build(GLuint objects, GLuint sorted, GLuint nodes, GLuint n_prims) {
+	if (n_prims == 0) {
+		return;
+	}
+	Reserve(n_prims);
+
+	SavedBinding saved[SAVED_BINDINGS];
+	for (int b = 0; b < SAVED_BINDINGS; b++) {
+		glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, b, &saved[b].buffer);
+		glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_START, b, &saved[b].start);
+		glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_SIZE, b, &saved[b].size);
+	}
+
+	const GLuint groups = Groups(n_prims);
+	const GLint n = (GLint)n_prims;
+
+	// Bounds and the centroid box. Encoded min starts high, encoded max starts at zero.
+	const GLuint init_bounds[6] = { 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0u, 0u, 0u };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, scene_bounds);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(init_bounds), init_bounds);
+
+	bounds.use();
+	bounds.setInt("n_prims", n);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objects);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, prim_bounds);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scene_bounds);
+	glDispatchCompute(groups, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	morton.use();
+	morton.setInt("n_prims", n);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, prim_bounds);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, scene_bounds);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, keys[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, vals[0]);
+	glDispatchCompute(groups, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// LSD radix sort, 8 passes of 4 bits. An even pass count leaves the result in keys[0].
+	for (int pass = 0; pass < 8; pass++) {
+		const int src = pass & 1;
+		const int dst = src ^ 1;
+
+		histogram.use();
+		histogram.setInt("n_keys", n);
+		histogram.setInt("shift", pass * 4);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keys[src]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, hist);
+		glDispatchCompute(groups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		scan.use();
+		scan.setInt("n_entries", (GLint)(16 * groups));
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		scatter.use();
+		scatter.setInt("n_keys", n);
+		scatter.setInt("shift", pass * 4);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keys[src]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, vals[src]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, keys[dst]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, vals[dst]);
+		glDispatchCompute(groups, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	if (n_prims > 1) {
+		hierarchy.use();
+		hierarchy.setInt("n_prims", n);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, keys[0]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, internal);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, parents);
+		glDispatchCompute(Groups(n_prims - 1), 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, visits);
+	glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, n_prims * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	fit.use();
+	fit.setInt("n_prims", n);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vals[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, prim_bounds);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, internal);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, parents);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, visits);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, node_bounds);
+	glDispatchCompute(groups, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	flatten.use();
+	flatten.setInt("n_prims", n);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, vals[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, internal);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, node_bounds);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, objects);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, sorted);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, nodes);
+	glDispatchCompute(Groups(2 * n_prims - 1), 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	for (int b = 0; b < SAVED_BINDINGS; b++) {
+		if (saved[b].size > 0) {
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, b, saved[b].buffer, (GLintptr)saved[b].start, (GLsizeiptr)saved[b].size);
+		} else {
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, saved[b].buffer);
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+
+/*
+ * LBVH built entirely on the GPU from an object SSBO, for scenes that move every frame.
+ * Passes: primitive bounds, Morton codes, 8 x 4 bit radix sort, Karras hierarchy
+ * emission, bottom-up fitting with atomics, and a flatten pass into the depth first
+ * BvhNode layout raycompute.comp traverses. Leaves hold one object each and the
+ * objects are gathered into leaf order in a second buffer, like Bvh::Build does on the host.
+ */
+class GpuBvhBuilder
+{
+private:
+	Shader<ShaderType::COMPUTE> bounds;
+	Shader<ShaderType::COMPUTE> morton;
+	Shader<ShaderType::COMPUTE> histogram;
+	Shader<ShaderType::COMPUTE> scan;
+	Shader<ShaderType::COMPUTE> scatter;
+	Shader<ShaderType::COMPUTE> hierarchy;
+	Shader<ShaderType::COMPUTE> fit;
+	Shader<ShaderType::COMPUTE> flatten;
+
+	// Scratch, grown on demand.
+	GLuint prim_bounds;
+	GLuint scene_bounds;
+	GLuint keys[2];
+	GLuint vals[2];
+	GLuint hist;
+	GLuint internal;
+	GLuint parents;
+	GLuint visits;
+	GLuint node_bounds;
+	GLuint capacity;
+
+	void Reserve(GLuint n_prims);
+
+public:
+	static const int BLOCK = 256;
+
+	GpuBvhBuilder();
+	~GpuBvhBuilder();
+
+	GpuBvhBuilder(const GpuBvhBuilder&) = delete;
+	GpuBvhBuilder& operator=(const GpuBvhBuilder&) = delete;
+
+	// Builds over n_prims Shapes in `objects`. `sorted` must hold n_prims Shapes and
+	// `nodes` 2 * n_prims - 1 BvhNodes. SSBO bindings 0-7 are restored afterwards.
+	void Build(GLuint objects, GLuint sorted, GLuint nodes, GLuint n_prims);
+};
@@ -0,0 +1,132 @@
+#include "GpuBvhRefitter.h"
+
+#include <algorithm>
+
+namespace {
+
+	const int SAVED_BINDINGS = 5;
+
+	struct SavedBinding {
+		GLint buffer;
+		GLint64 start;
+		GLint64 size;
+	};
+
+	GLuint Groups(GLuint n) {
+		return (n + GpuBvhRefitter::BLOCK - 1) / GpuBvhRefitter::BLOCK;
+	}
+
+	void Save(SavedBinding* saved) {
+		for (int b = 0; b < SAVED_BINDINGS; b++) {
+			glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, b, &saved[b].buffer);
+			glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_START, b, &saved[b].start);
+			glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_SIZE, b, &saved[b].size);
+		}
+	}
+
+	void Restore(const SavedBinding* saved) {
+		for (int b = 0; b < SAVED_BINDINGS; b++) {
+			if (saved[b].size > 0) {
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, b, saved[b].buffer, (GLintptr)saved[b].start, (GLsizeiptr)saved[b].size);
+			} else {
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, saved[b].buffer);
+			}
+		}
+	}
+}
+
+GpuBvhRefitter::GpuBvhRefitter() :
+	refit("bvh_refit.comp"),
+	cost("bvh_cost.comp"),
+	n_leaves(0),
+	n_nodes(0) {
+
+	glGenBuffers(1, &leaves);
+	glGenBuffers(1, &parents);
+	glGenBuffers(1, &visits);
+	glGenBuffers(1, &partials);
+}
+
+GpuBvhRefitter::~GpuBvhRefitter() {
+	glDeleteBuffers(1, &leaves);
+	glDeleteBuffers(1, &parents);
+	glDeleteBuffers(1, &visits);
+	glDeleteBuffers(1, &partials);
+}
+
+void GpuBvhRefitter::SetTopology(const std::vector<BvhNode>& nodes) {
+	std::vector<GLuint> leaf_list;
+	for (GLuint i = 0; i < nodes.size(); i++) {
+		if (nodes[i].count > 0) {
+			leaf_list.push_back(i);
+		}
+	}
+	std::vector<GLuint> parent_list = Bvh::Parents(nodes);
+	n_leaves = (GLuint)leaf_list.size();
+	n_nodes = (GLuint)nodes.size();
+
+	// Zero sized stores are not allowed, keep at least one element.
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, leaves);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<GLuint>(n_leaves, 1) * sizeof(GLuint), leaf_list.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, parents);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<GLuint>(n_nodes, 1) * sizeof(GLuint), parent_list.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, visits);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<GLuint>(n_nodes, 1) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, partials);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<GLuint>(Groups(n_nodes), 1) * sizeof(float), nullptr, GL_DYNAMIC_READ);
+}
+
+void GpuBvhRefitter::Refit(GLuint objects, GLuint nodes) {
+	if (n_leaves == 0) {
+		return;
+	}
+
+	SavedBinding saved[SAVED_BINDINGS];
+	Save(saved);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, visits);
+	glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, n_nodes * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+	refit.use();
+	refit.setInt("n_leaves", (GLint)n_leaves);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objects);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, leaves);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, parents);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visits);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, nodes);
+	glDispatchCompute(Groups(n_leaves), 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	Restore(saved);
+}
+
+float GpuBvhRefitter::Cost(GLuint nodes) {
+	if (n_nodes == 0) {
+		return 0.0f;
+	}
+
+	SavedBinding saved[SAVED_BINDINGS];
+	Save(saved);
+
+	cost.use();
+	cost.setInt("n_nodes", (GLint)n_nodes);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, nodes);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, partials);
+	glDispatchCompute(Groups(n_nodes), 1, 1);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	Restore(saved);
+
+	std::vector<float> sums(Groups(n_nodes));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, partials);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sums.size() * sizeof(float), sums.data());
+	BvhNode root;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, nodes);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(BvhNode), &root);
+
+	double total = 0.0;
+	for (float s : sums) {
+		total += s;
+	}
+	return (float)(total / std::max(Bvh::Area(root), 1e-12f));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "Bvh.h"
+
+/*
+ * Refits the boxes of a BvhNode SSBO in place after objects moved on the device,
+ * keeping its topology. One invocation per leaf climbs to the root like the LBVH
+ * fit pass. Cost() reduces the SAH cost on the device so DynamicBvh can decide
+ * when the tree has degraded enough to rebuild.
+ */
+class GpuBvhRefitter
+{
+private:
+	Shader<ShaderType::COMPUTE> refit;
+	Shader<ShaderType::COMPUTE> cost;
+
+	GLuint leaves;
+	GLuint parents;
+	GLuint visits;
+	GLuint partials;
+	GLuint n_leaves;
+	GLuint n_nodes;
+
+public:
+	static const int BLOCK = 256;
+
+	GpuBvhRefitter();
+	~GpuBvhRefitter();
+
+	GpuBvhRefitter(const GpuBvhRefitter&) = delete;
+	GpuBvhRefitter& operator=(const GpuBvhRefitter&) = delete;
+
+	// Uploads the parent links and leaf list. Needed once per build, not per refit.
+	void SetTopology(const std::vector<BvhNode>& nodes);
+
+	// Recomputes every box in `nodes` from the Shapes in `objects`, bottom-up.
+	// SSBO bindings 0-4 are restored afterwards.
+	void Refit(GLuint objects, GLuint nodes);
+
+	// Normalized SAH cost of `nodes`, same as Bvh::Cost. Reads back one float per
+	// workgroup, so it stalls the pipeline; call it every few frames rather than each one.
+	float Cost(GLuint nodes);
+};
@@ -0,0 +1,117 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "TraceRecorder.h"
+
+GpuProfiler::GpuProfiler() : next(0), open(false), trace(nullptr) {
+	glGenQueries(2 * RING, ids);
+}
+
+GpuProfiler::~GpuProfiler() {
+	glDeleteQueries(2 * RING, ids);
+}
+
+void GpuProfiler::Begin(const std::string& pass, double rays) {
+	if (open) {
+		std::cout << "ERR::PROFILER::NESTED_PASS " << pass << std::endl;
+		return;
+	}
+
+	int index = 0;
+	while (index < (int)passes.size() && passes[index].name != pass) index++;
+	if (index == (int)passes.size()) {
+		passes.emplace_back();
+		passes.back().name = pass;
+	}
+
+	// Ring full: the oldest query is the one about to be reused, so wait for it.
+	if ((int)pending.size() == RING) {
+		Read(pending.front());
+		pending.erase(pending.begin());
+	}
+
+	Query q = { ids[2 * next], ids[2 * next + 1], index, rays };
+	next = (next + 1) % RING;
+	glQueryCounter(q.start, GL_TIMESTAMP);
+	pending.push_back(q);
+	open = true;
+}
+
+void GpuProfiler::End() {
+	if (!open) return;
+	glQueryCounter(pending.back().end, GL_TIMESTAMP);
+	open = false;
+}
+
+void GpuProfiler::Read(const Query& q) {
+	GLuint64 start = 0, end = 0;
+	glGetQueryObjectui64v(q.start, GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(q.end, GL_QUERY_RESULT, &end);
+	Pass& p = passes[q.pass];
+	const double ms = (end > start) ? (end - start) * 1e-6 : 0.0;
+	if ((int)p.ms.size() < HISTORY) {
+		p.ms.push_back(ms);
+	} else {
+		p.ms[p.calls % HISTORY] = ms;
+	}
+	p.calls++;
+	if (q.rays > 0.0) {
+		p.rays += q.rays;
+		p.seconds += ms * 1e-3;
+	}
+	if (trace) {
+		trace->Gpu(p.name, start, end);
+	}
+}
+
+void GpuProfiler::Collect() {
+	// The one still open cannot be available yet.
+	const size_t closed = pending.size() - (open ? 1 : 0);
+	size_t done = 0;
+	while (done < closed) {
+		GLint available = GL_FALSE;
+		// Results arrive in order, the end being available implies the start is.
+		glGetQueryObjectiv(pending[done].end, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) break;
+		Read(pending[done]);
+		done++;
+	}
+	pending.erase(pending.begin(), pending.begin() + done);
+}
+
+std::vector<GpuProfiler::Stats> GpuProfiler::Report() const {
+	std::vector<Stats> report;
+	for (const Pass& p : passes) {
+		Stats s = { p.name, p.calls, 0.0, 0.0, 0.0, 0.0 };
+		if (!p.ms.empty()) {
+			std::vector<double> sorted = p.ms;
+			std::sort(sorted.begin(), sorted.end());
+			double sum = 0.0;
+			for (double ms : sorted) sum += ms;
+			s.min_ms = sorted.front();
+			s.avg_ms = sum / sorted.size();
+			s.p99_ms = sorted[std::min(sorted.size() - 1, (size_t)(0.99 * sorted.size()))];
+		}
+		s.rays_per_s = (p.seconds > 0.0) ? p.rays / p.seconds : 0.0;
+		report.push_back(s);
+	}
+	return report;
+}
+
+void GpuProfiler::Print(std::ostream& out) const {
+	out << std::setw(12) << "pass" << std::setw(10) << "calls" << std::setw(12) << "min ms" << std::setw(12) << "avg ms"
+		<< std::setw(12) << "p99 ms" << std::setw(12) << "Mrays/s" << std::endl;
+	for (const Stats& s : Report()) {
+		out << std::setw(12) << s.name << std::setw(10) << s.calls << std::setw(12) << s.min_ms << std::setw(12) << s.avg_ms
+			<< std::setw(12) << s.p99_ms << std::setw(12);
+		if (s.rays_per_s > 0.0) {
+			out << s.rays_per_s * 1e-6;
+		} else {
+			out << '-';
+		}
+		out << std::endl;
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+class TraceRecorder;
+
+/*
+ * GPU time per pass from pairs of GL_TIMESTAMP queries written by Begin and End
+ * around the GL calls of the pass. TIME_ELAPSED would take one query per pass,
+ * but llvmpipe reports compute dispatches as taking 1 ns under it. Passes must
+ * not nest. Queries come from a fixed ring and are read back by Collect() only
+ * once the driver says they are available, so profiling costs no stall unless
+ * more than RING passes are in flight, in which case Begin waits for the oldest.
+ */
+class GpuProfiler
+{
+public:
+	static const int RING = 64;
+	// Most recent timings kept per pass for min, avg and p99.
+	static const int HISTORY = 4096;
+
+	struct Stats {
+		std::string name;
+		uint64_t calls;		// timed so far
+		double min_ms;
+		double avg_ms;
+		double p99_ms;
+		double rays_per_s;	// 0 if the pass was timed without a ray count
+	};
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// `rays` traced by the pass, for rays per GPU second.
+	void Begin(const std::string& pass, double rays = 0.0);
+	void End();
+
+	// Reads back every finished query, oldest first. Never waits.
+	void Collect();
+
+	// Also hands every timing read back to `trace`, null stops it.
+	void SetTrace(TraceRecorder* trace) {
+		this->trace = trace;
+	}
+
+	// Over the last HISTORY timings of each pass, in the order passes first ran.
+	std::vector<Stats> Report() const;
+	void Print(std::ostream& out) const;
+
+private:
+	struct Pass {
+		std::string name;
+		uint64_t calls = 0;
+		std::vector<double> ms;		// ring of the last HISTORY
+		double rays = 0.0;
+		double seconds = 0.0;		// of the timings that came with rays
+	};
+
+	struct Query {
+		GLuint start;
+		GLuint end;
+		int pass;
+		double rays;
+	};
+
+	std::vector<Pass> passes;
+	GLuint ids[2 * RING];
+	std::vector<Query> pending;		// begun, not read back yet, oldest first
+	int next;
+	bool open;
+	TraceRecorder* trace;
+
+	void Read(const Query& q);
+};
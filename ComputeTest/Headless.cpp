@@ -0,0 +1,607 @@
+#include <iostream>
+#include "glad/glad.h"
+
+#include "HeadlessContext.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "ShaderStructs.h"
+#include "Scene.h"
+#include "Bvh.h"
+#include "CpuTracer.h"
+#include "GpuBvhBuilder.h"
+#include "Mesh.h"
+#include "SceneFile.h"
+#include "Tile.h"
+#include "WavefrontTracer.h"
+#include "FrameUniforms.h"
+#include "ProgramCache.h"
+#include "RayVariant.h"
+#include "GpuProfiler.h"
+#include "RayStats.h"
+#include "TraceRecorder.h"
+#include "Image.h"
+#include "Convergence.h"
+#include "Lights.h"
+#include "Sampler.h"
+#include "BlueNoise.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+/*
+ * Batch renderer: traces the scene for a fixed number of samples per pixel into an
+ * offscreen image, writes it out as a binary PPM and exits. No window, monitor or
+ * display server is needed, so many of these can be packed onto one render node.
+ * With --cpu the same scene is traced by CpuTracer instead and no GL context is made.
+ * With --gpu-bvh the acceleration structure is built by GpuBvhBuilder instead of on the host.
+ * With --instances the Cornell box is swapped for InstancedField, traced through a two level BVH.
+ * With --lamps its lamp is swapped for that many small glowing balls, see LampCloud.
+ * With --mesh an OBJ or PLY model is fitted into the Cornell box next to the block.
+ * With --scene-cache host built scenes are written to, and next time mapped from, that directory.
+ * With --shader-cache linked program binaries are too, see ProgramCache.
+ * The shader is compiled without the materials and shapes the scene lacks, or with all of them
+ * with --full-shader. --depth bounds the path length at compile time. Lamps are sampled directly at
+ * every diffuse bounce, see Lights, unless --no-nee; the CPU port never does.
+ * With --tile the shader is compiled for another workgroup shape from Tile.h.
+ * With --sampler the shader draws its numbers from another Sampler: scrambled Sobol points, per
+ * pixel by --seed, or a rank-1 lattice dithered by a BlueNoise mask. The CPU port is always random.
+ * With --wavefront every bounce runs as separate queue driven kernels, see WavefrontTracer.
+ * --sorted implies it and shades hits grouped by material in one kernel instead of one per material.
+ * With --profile the GPU time of every pass is measured with timer queries and printed at the end.
+ * With --ray-stats the shader is built to count rays, shape tests and path ends, see RayStats.
+ * With --trace the CPU phases and GPU passes of every sample are written as a Chrome trace.
+ * -o out.pfm keeps the float radiance, e.g. for a high sample count reference, rendered with another
+ * --seed so its noise is independent of the runs measured against it. With --reference
+ * the image is compared to one after every sample, see Convergence, and the time each --threshold
+ * of relMSE took is printed at the end; --curve writes every point. Comparing is not timed.
+ */
+
+static void PrintUsage() {
+	std::cout << "Usage: TracerHeadless [-w width] [-h height] [-s samples] [-c chunks_x chunks_y] [-o out.ppm] [--cpu threads] [--gpu-bvh] [--instances count] [--lamps count] [--mesh model.obj|ply] [--scene-cache dir] [--shader-cache dir] [--full-shader] [--no-nee] [--depth n] [--tile 8x8|16x8|32x1] [--sampler random|sobol|bluenoise] [--wavefront] [--sorted] [--profile] [--ray-stats] [--trace out.json] [--reference ref.pfm [--threshold relmse]... [--curve out.csv]] [--seed n]" << std::endl;
+}
+
+// Where --mesh puts the model inside the Cornell box.
+static const glm::vec3 MESH_CENTER(1.0f, -1.6f, -0.5f);
+static const float MESH_SIZE = 2.8f;
+
+// The Cornell box, lit by its lamp or by `lamps` small ones.
+static std::vector<Shape> BoxScene(int lamps) {
+	return (lamps > 0) ? LampCloud(lamps) : CornellScene();
+}
+
+// Hash of everything BuildScene reads, including the builder settings that shape the trees.
+static bool SceneKey(int instances, int lamps, const std::string& mesh_path, uint64_t& key) {
+	SceneHash hash;
+	hash.Add(SceneFile::VERSION);
+	hash.Add(Bvh::BINS);
+	hash.Add(Bvh::MAX_LEAF);
+	hash.Add(Bvh::MAX_DEPTH);
+	hash.Add(instances);
+	if (instances == 0) {
+		hash.Add(BoxScene(lamps));
+	}
+	if (!mesh_path.empty()) {
+		hash.Add(MESH_CENTER);
+		hash.Add(MESH_SIZE);
+		if (!hash.AddFile(mesh_path)) {
+			return false;
+		}
+	}
+	key = hash.Value();
+	return true;
+}
+
+// Builds the scene on the host. Without `host_bvh` the shapes are left in `unsorted` for GpuBvhBuilder.
+static bool BuildScene(int instances, int lamps, const std::string& mesh_path, bool host_bvh, SceneData& scene, std::vector<Shape>& unsorted) {
+	if (instances > 0) {
+		TwoLevelBvh field = InstancedField(instances);
+		std::cout << "Two level BVH: " << field.Instances().size() << " instances of " << field.Groups() << " groups, "
+			<< field.Shapes().size() << " shapes, " << field.Nodes().size() << " + " << field.TopNodes().size() << " nodes, "
+			<< field.Bytes() / 1024.0 << " KiB" << std::endl;
+		scene.shapes = field.Shapes();
+		scene.nodes = field.Nodes();
+		scene.top = field.TopNodes();
+		scene.instances = field.Instances();
+		return true;
+	}
+
+	std::vector<Shape> obj = BoxScene(lamps);
+	Lights::Tag(obj);
+
+	// Triangles live in their own buffers, the scene only holds one MeshShape per model.
+	if (!mesh_path.empty()) {
+		Mesh mesh;
+		MeshPool meshes;
+		if (!LoadMesh(mesh_path, mesh)) {
+			return false;
+		}
+		FitMesh(mesh, MESH_CENTER, MESH_SIZE);
+		obj.push_back(meshes.Add(mesh, glm::vec3(0.8f), 1.0f, MaterialType::LAMBERTIAN));
+		std::cout << "Mesh: " << mesh.vertices.size() << " vertices, " << meshes.Triangles() << " triangles, " << meshes.Nodes().size() << " nodes" << std::endl;
+		scene.mesh_nodes = meshes.Nodes();
+		scene.vertices = meshes.Vertices();
+		scene.indices = meshes.Indices();
+	}
+
+	if (host_bvh) {
+		scene.nodes = Bvh::Build(obj);
+		std::cout << "BVH: " << scene.nodes.size() << " nodes over " << obj.size() << " objects, SAH cost " << Bvh::Cost(scene.nodes) << std::endl;
+		scene.shapes = obj;
+	} else {
+		unsorted = obj;
+	}
+	return true;
+}
+
+// Reference path: no GL at all, just the CPU port of the shader.
+static int RenderCpu(int width, int height, int samples, int threads, int lamps, unsigned seed, const std::string& output) {
+	Camera cam({ 0,0,16 }, { 0,0,0 }, { 0,1,0 }, 30.0f, (float)width / (float)height);
+	CpuTracer tracer(BoxScene(lamps), cam, width, height, threads, seed);
+	std::cout << "CPU tracer on " << tracer.Threads() << " threads" << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int sample = 0; sample < samples; sample++) {
+		tracer.Render(1);
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Samples: " << std::setw(4) << sample + 1 << '/' << samples << " SPS: " << std::setw(7) << (sample + 1) / elapsed << "\t\t\t\r" << std::flush;
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << std::endl;
+
+	uint64_t total_rays = 0;
+	std::vector<CpuTracer::ThreadStats> stats = tracer.Stats();
+	for (size_t i = 0; i < stats.size(); i++) {
+		const CpuTracer::ThreadStats& st = stats[i];
+		total_rays += st.rays;
+		std::cout << "Thread " << std::setw(3) << i << ": " << std::setw(12) << st.rays << " rays " << std::setw(8) << st.tiles << " tiles "
+			<< std::setw(6) << st.steals << " steals " << std::setw(10) << (st.busy_seconds > 0.0 ? st.rays / st.busy_seconds * 1e-6 : 0.0) << " Mrays/s" << std::endl;
+	}
+	std::cout << "Rendered " << samples << " spp at " << width << 'x' << height << " in " << elapsed << " s ("
+		<< (double)width * height * samples / elapsed * 1e-6 << " Msamples/s, " << total_rays / elapsed * 1e-6 << " Mrays/s)" << std::endl;
+
+	const std::vector<glm::vec4>& image = tracer.Image();
+	std::vector<float> pixels((const float*)image.data(), (const float*)(image.data() + image.size()));
+	if (!Image::Write(output, width, height, pixels)) {
+		std::cerr << "ERR::IMAGE::WRITE_FAIL " << output << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+
+	int WIDTH	 = 1920;
+	int HEIGHT	 = 1080;
+	int SAMPLES  = 64;
+	int CHUNKS_X = 2;
+	int CHUNKS_Y = 2;
+	std::string output = "render.ppm";
+	bool cpu = false;
+	bool gpu_bvh = false;
+	bool wavefront = false;
+	bool sorted = false;
+	int THREADS = 0;
+	int INSTANCES = 0;
+	int LAMPS = 0;
+	std::string mesh_path;
+	std::string cache_dir;
+	std::string shader_cache_dir;
+	bool specialize = true;
+	bool nee = true;
+	bool profile = false;
+	bool ray_stats = false;
+	std::string trace_path;
+	std::string reference_path;
+	std::string curve_path;
+	std::vector<double> thresholds;
+	unsigned seed = std::default_random_engine::default_seed;
+	int max_depth = RayVariant().max_depth;
+	const Tile* tile = &TILES[0];
+	const Sampler* sampler = &SAMPLERS[0];
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "-w" && i + 1 < argc) {
+			WIDTH = std::atoi(argv[++i]);
+		} else if (arg == "-h" && i + 1 < argc) {
+			HEIGHT = std::atoi(argv[++i]);
+		} else if (arg == "-s" && i + 1 < argc) {
+			SAMPLES = std::atoi(argv[++i]);
+		} else if (arg == "-c" && i + 2 < argc) {
+			CHUNKS_X = std::atoi(argv[++i]);
+			CHUNKS_Y = std::atoi(argv[++i]);
+		} else if (arg == "-o" && i + 1 < argc) {
+			output = argv[++i];
+		} else if (arg == "--cpu" && i + 1 < argc) {
+			cpu = true;
+			THREADS = std::atoi(argv[++i]);
+		} else if (arg == "--gpu-bvh") {
+			gpu_bvh = true;
+		} else if (arg == "--instances" && i + 1 < argc) {
+			INSTANCES = std::atoi(argv[++i]);
+		} else if (arg == "--lamps" && i + 1 < argc) {
+			LAMPS = std::atoi(argv[++i]);
+		} else if (arg == "--mesh" && i + 1 < argc) {
+			mesh_path = argv[++i];
+		} else if (arg == "--scene-cache" && i + 1 < argc) {
+			cache_dir = argv[++i];
+		} else if (arg == "--profile") {
+			profile = true;
+		} else if (arg == "--ray-stats") {
+			ray_stats = true;
+		} else if (arg == "--trace" && i + 1 < argc) {
+			trace_path = argv[++i];
+		} else if (arg == "--reference" && i + 1 < argc) {
+			reference_path = argv[++i];
+		} else if (arg == "--threshold" && i + 1 < argc) {
+			thresholds.push_back(std::atof(argv[++i]));
+		} else if (arg == "--curve" && i + 1 < argc) {
+			curve_path = argv[++i];
+		} else if (arg == "--seed" && i + 1 < argc) {
+			seed = (unsigned)std::atoi(argv[++i]);
+		} else if (arg == "--full-shader") {
+			specialize = false;
+		} else if (arg == "--no-nee") {
+			nee = false;
+		} else if (arg == "--depth" && i + 1 < argc) {
+			max_depth = std::atoi(argv[++i]);
+		} else if (arg == "--shader-cache" && i + 1 < argc) {
+			shader_cache_dir = argv[++i];
+		} else if (arg == "--wavefront") {
+			wavefront = true;
+		} else if (arg == "--sorted") {
+			wavefront = true;
+			sorted = true;
+		} else if (arg == "--tile" && i + 1 < argc) {
+			tile = FindTile(argv[++i]);
+			if (!tile) {
+				PrintUsage();
+				return 1;
+			}
+		} else if (arg == "--sampler" && i + 1 < argc) {
+			sampler = FindSampler(argv[++i]);
+			if (!sampler) {
+				PrintUsage();
+				return 1;
+			}
+		} else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (WIDTH <= 0 || HEIGHT <= 0 || SAMPLES <= 0 || max_depth <= 0 || CHUNKS_X <= 0 || CHUNKS_Y <= 0 || INSTANCES < 0 || LAMPS < 0) {
+		PrintUsage();
+		return 1;
+	}
+
+	// Neither the CPU port nor the LBVH builder know about instances.
+	if (INSTANCES > 0 && (cpu || gpu_bvh)) {
+		std::cerr << "ERR::INSTANCES_UNSUPPORTED with --cpu or --gpu-bvh" << std::endl;
+		return 1;
+	}
+	// The lamps light the Cornell box, the instanced field has its own.
+	if (LAMPS > 0 && INSTANCES > 0) {
+		std::cerr << "ERR::LAMPS_UNSUPPORTED with --instances" << std::endl;
+		return 1;
+	}
+	// Meshes go into the Cornell box, which the CPU port traces without them.
+	if (!mesh_path.empty() && (cpu || INSTANCES > 0)) {
+		std::cerr << "ERR::MESH_UNSUPPORTED with --cpu or --instances" << std::endl;
+		return 1;
+	}
+
+	// The wavefront queues and stats are sized for its longest path.
+	if (wavefront && max_depth > WavefrontTracer::MAX_DEPTH) {
+		std::cerr << "ERR::DEPTH_UNSUPPORTED above " << WavefrontTracer::MAX_DEPTH << " with --wavefront" << std::endl;
+		return 1;
+	}
+
+	// Chunks must divide the screen properly.
+	if (HEIGHT % CHUNKS_Y != 0 || WIDTH % CHUNKS_X != 0) {
+		std::cerr << "ERR::TEX_CHUNKS_INDIVISIBLE" << std::endl;
+		return 1;
+	}
+
+	// The reference must be of this very render, only with more samples.
+	std::unique_ptr<Convergence> convergence;
+	if (!reference_path.empty()) {
+		int ref_w = 0, ref_h = 0;
+		std::vector<float> reference;
+		if (!Image::Read(reference_path, ref_w, ref_h, reference)) {
+			return 1;
+		}
+		if (ref_w != WIDTH || ref_h != HEIGHT) {
+			std::cerr << "ERR::REFERENCE_SIZE " << ref_w << 'x' << ref_h << " for " << WIDTH << 'x' << HEIGHT << std::endl;
+			return 1;
+		}
+		convergence.reset(new Convergence(reference, WIDTH, HEIGHT));
+	}
+	if (thresholds.empty()) {
+		thresholds = { 0.1, 0.03, 0.01 };
+	}
+
+	if (cpu) {
+		if (convergence) {
+			std::cerr << "ERR::REFERENCE_UNSUPPORTED with --cpu" << std::endl;
+			return 1;
+		}
+		return RenderCpu(WIDTH, HEIGHT, SAMPLES, THREADS, LAMPS, seed, output);
+	}
+
+	auto startup = std::chrono::steady_clock::now();
+	HeadlessContext context;
+	if (!context.Init(4, 5)) {
+		return 1;
+	}
+	ProgramCache::SetDirectory(shader_cache_dir);
+
+	std::cout << glGetString(GL_VENDOR) << ' ' << glGetString(GL_RENDERER) << std::endl;
+
+	// Output image, accumulated in place by the compute shader.
+	GLuint tex_output;
+	glGenTextures(1, &tex_output);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, tex_output);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, WIDTH, HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+	glBindImageTexture(0, tex_output, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+	// Scene buffers. The host built scene goes through SceneData so it can be cached and mapped next time.
+	SceneData scene;
+	MappedScene mapped;
+	const SceneFile::View* sections = nullptr;
+	SceneFile::View views[(int)SceneFile::Section::COUNT];
+	std::vector<Shape> unsorted;
+	std::string cache_path;
+	uint64_t key = 0;
+	if (!cache_dir.empty() && !gpu_bvh) {
+		if (!SceneKey(INSTANCES, LAMPS, mesh_path, key)) {
+			std::cerr << "ERR::MESH::FILE_NOT_FOUND " << mesh_path << std::endl;
+			return 1;
+		}
+		std::ostringstream name;
+		name << cache_dir << '/' << std::hex << std::setw(16) << std::setfill('0') << key << ".scene";
+		cache_path = name.str();
+
+		auto map_start = std::chrono::steady_clock::now();
+		if (mapped.Open(cache_path, key)) {
+			for (int i = 0; i < (int)SceneFile::Section::COUNT; i++) {
+				views[i] = mapped.Get((SceneFile::Section)i);
+			}
+			sections = views;
+			std::cout << "Scene: mapped " << cache_path << " in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - map_start).count() << " ms" << std::endl;
+		}
+	}
+	if (!sections) {
+		auto build_start = std::chrono::steady_clock::now();
+		if (!BuildScene(INSTANCES, LAMPS, mesh_path, !gpu_bvh, scene, unsorted)) {
+			return 1;
+		}
+		std::cout << "Scene: built in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - build_start).count() << " ms" << std::endl;
+		if (!cache_path.empty() && WriteSceneFile(cache_path, key, scene)) {
+			std::cout << "Scene: cached as " << cache_path << std::endl;
+		}
+		for (int i = 0; i < (int)SceneFile::Section::COUNT; i++) {
+			views[i] = scene.Get((SceneFile::Section)i);
+		}
+		sections = views;
+	}
+
+	// Straight from the mapping or the host copy into the SSBOs, empty sections stay unbound.
+	GLuint SSBO_scene[(int)SceneFile::Section::COUNT];
+	glGenBuffers((int)SceneFile::Section::COUNT, SSBO_scene);
+	for (int i = 0; i < (int)SceneFile::Section::COUNT; i++) {
+		if (sections[i].bytes == 0) continue;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_scene[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sections[i].bytes, sections[i].data, GL_STATIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SceneFile::BINDINGS[i], SSBO_scene[i]);
+	}
+	FrameUniforms frame;
+	frame.Block().n_instances = (int)(sections[(int)SceneFile::Section::INSTANCES].bytes / sizeof(BvhInstance));
+
+	// The GPU builder sorts a copy of the shapes, the host ones are sorted already.
+	const SceneFile::View& shapes = sections[(int)SceneFile::Section::SHAPES];
+	const Shape* scene_shapes = gpu_bvh ? unsorted.data() : (const Shape*)shapes.data;
+	const size_t scene_count = gpu_bvh ? unsorted.size() : shapes.bytes / sizeof(Shape);
+	Lights lights(scene_shapes, scene_count);
+	std::cout << "Lights: " << lights.Count() << " sampled, " << lights.Tree().size() << " tree nodes" << std::endl;
+
+	// Compiled for what the scene holds, so unused materials and shapes cost nothing.
+	RayVariant variant;
+	if (specialize) {
+		variant = RayVariant::ForScene(scene_shapes, scene_count, frame.Block().n_instances > 0, false);
+	}
+	variant.nee = variant.nee && nee;
+	variant.max_depth = max_depth;
+	std::cout << "Variant: " << variant.Name() << std::endl;
+	std::cout << "Sampler: " << sampler->name << std::endl;
+	const std::string defines = variant.Defines() + sampler->Defines() + (ray_stats ? RayStats::Defines() : "");
+	std::unique_ptr<BlueNoise> blue_noise;
+	if (sampler->blue_noise) {
+		blue_noise.reset(new BlueNoise());
+	}
+	Shader<ShaderType::COMPUTE> compshdr("raycompute.comp", tile->Defines() + defines);
+
+	if (gpu_bvh) {
+		// Upload the scene as is and let the builder sort it into objbuf.
+		const GLuint n = (GLuint)unsorted.size();
+		const GLuint SSBO_objects = SSBO_scene[(int)SceneFile::Section::SHAPES];
+		const GLuint SSBO_bvh = SSBO_scene[(int)SceneFile::Section::BVH];
+		GLuint SSBO_unsorted;
+		glGenBuffers(1, &SSBO_unsorted);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_unsorted);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(Shape), unsorted.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_objects);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, n * sizeof(Shape), nullptr, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO_bvh);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (2 * n - 1) * sizeof(BvhNode), nullptr, GL_DYNAMIC_COPY);
+
+		GpuBvhBuilder builder;
+		builder.Build(SSBO_unsorted, SSBO_objects, SSBO_bvh, n);
+		glFinish();
+		glDeleteBuffers(1, &SSBO_unsorted);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_objects);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_bvh);
+		std::cout << "BVH: " << 2 * n - 1 << " nodes over " << n << " objects, built on the GPU" << std::endl;
+	}
+
+	Camera cam({ 0,0,16 }, { 0,0,0 }, { 0,1,0 }, 30.0f, (float)WIDTH / (float)HEIGHT);
+	cam.Bind(frame.Block());
+	frame.Block().skybox_active = false;
+	frame.Block().seed = seed;
+
+	const int CHUNK_W = WIDTH / CHUNKS_X;
+	const int CHUNK_H = HEIGHT / CHUNKS_Y;
+
+	// The trace takes its GPU track from the profiler, which only prints with --profile.
+	std::unique_ptr<TraceRecorder> trace;
+	std::unique_ptr<GpuProfiler> profiler;
+	if (profile || !trace_path.empty()) {
+		profiler.reset(new GpuProfiler());
+	}
+	if (!trace_path.empty()) {
+		trace.reset(new TraceRecorder(trace_path));
+		profiler->SetTrace(trace.get());
+	}
+
+	std::unique_ptr<RayStats> stats;
+	RayStats::Counts totals = {};
+	if (ray_stats) {
+		stats.reset(new RayStats());
+	}
+
+	std::unique_ptr<WavefrontTracer> wf;
+	if (wavefront) {
+		wf.reset(new WavefrontTracer(CHUNK_W * CHUNK_H, defines));
+		wf->SetShading(sorted ? WavefrontTracer::Shading::SORTED : WavefrontTracer::Shading::QUEUES);
+		wf->SetProfiler(profiler.get());
+	}
+
+	// Cold against warm startup: everything up to the first dispatch, and how much of it was shaders.
+	const ProgramCache::Stats& programs = ProgramCache::Statistics();
+	std::cout << "Programs: " << programs.programs << " linked, " << programs.hits << " from the cache in " << programs.load_ms << " ms, "
+		<< programs.programs - programs.hits << " compiled in " << programs.compile_ms << " ms" << std::endl;
+	std::cout << "Startup: " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup).count() << " ms" << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	double measuring = 0.0;		// seconds spent comparing against the reference, left out of the timings
+	std::vector<float> pixels(WIDTH * HEIGHT * 4);
+	for (int sample = 0; sample < SAMPLES; sample++) {
+		TraceScope sample_scope(trace.get(), "sample");
+		frame.Block().iteration = sample;
+		frame.Block().time = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+		for (int chunk_y = 0; chunk_y < CHUNKS_Y; chunk_y++) {
+			for (int chunk_x = 0; chunk_x < CHUNKS_X; chunk_x++) {
+				frame.Block().SetChunk(glm::ivec2(chunk_x * CHUNK_W, chunk_y * CHUNK_H), glm::ivec2(CHUNK_W, CHUNK_H));
+				if (wf) {
+					TraceScope scope(trace.get(), "wavefront");
+					wf->Trace(frame);
+					continue;
+				}
+				{
+					TraceScope scope(trace.get(), "uniforms");
+					frame.Commit();
+				}
+				TraceScope scope(trace.get(), "dispatch");
+				compshdr.use();
+				if (profiler) profiler->Begin("dispatch", (double)CHUNK_W * CHUNK_H);
+				tile->Dispatch(CHUNK_W, CHUNK_H);
+				if (profiler) profiler->End();
+			}
+		}
+		// Next sample reads back the accumulated pixel.
+		if (profiler) profiler->Begin("barrier");
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+		if (profiler) profiler->End();
+		{
+			TraceScope scope(trace.get(), "finish");
+			glFinish();
+		}
+		if (profiler) profiler->Collect();
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - measuring;
+		std::cout << "Samples: " << std::setw(4) << sample + 1 << '/' << SAMPLES << " SPS: " << std::setw(7) << (sample + 1) / elapsed;
+		if (trace) trace->Counter("samples/s", (sample + 1) / elapsed);
+		if (stats) {
+			// A line per sample, the read back stalls anyway.
+			TraceScope scope(trace.get(), "readback");
+			const RayStats::Counts counts = stats->Read();
+			for (int i = 0; i < RayStats::COUNT; i++) totals[i] += counts[i];
+			std::cout << ' ';
+			RayStats::PrintLine(std::cout, counts);
+		}
+		if (convergence) {
+			TraceScope scope(trace.get(), "compare");
+			auto measure = std::chrono::steady_clock::now();
+			glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			glBindTexture(GL_TEXTURE_2D, tex_output);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
+			const Convergence::Point& p = convergence->Add(sample + 1, elapsed, pixels);
+			std::cout << " RMSE: " << p.rmse << " relMSE: " << p.relmse;
+			measuring += std::chrono::duration<double>(std::chrono::steady_clock::now() - measure).count();
+		}
+		if (stats || convergence) {
+			std::cout << std::endl;
+		} else {
+			std::cout << "\t\t\t\r" << std::flush;
+		}
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - measuring;
+	if (!stats && !convergence) {
+		std::cout << std::endl;
+	}
+	std::cout << "Rendered " << SAMPLES << " spp at " << WIDTH << 'x' << HEIGHT << " in " << elapsed << " s ("
+		<< (double)WIDTH * HEIGHT * SAMPLES / elapsed * 1e-6 << " Msamples/s)" << std::endl;
+	if (profile) {
+		profiler->Print(std::cout);
+	}
+	if (stats) {
+		RayStats::Print(std::cout, totals);
+	}
+	if (convergence) {
+		for (double threshold : thresholds) {
+			const Convergence::Point* p = convergence->Reached(threshold);
+			std::cout << "relMSE <= " << threshold << ": ";
+			if (p) {
+				std::cout << p->samples << " spp in " << p->seconds << " s" << std::endl;
+			} else {
+				std::cout << "not reached" << std::endl;
+			}
+		}
+		if (!curve_path.empty()) {
+			std::ofstream curve(curve_path);
+			convergence->WriteCsv(curve);
+			if (!curve) {
+				std::cerr << "ERR::CURVE::WRITE_FAIL " << curve_path << std::endl;
+			}
+		}
+	}
+
+	glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+	glBindTexture(GL_TEXTURE_2D, tex_output);
+	{
+		TraceScope scope(trace.get(), "readback");
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, pixels.data());
+	}
+
+	int status = 0;
+	if (!Image::Write(output, WIDTH, HEIGHT, pixels)) {
+		std::cerr << "ERR::IMAGE::WRITE_FAIL " << output << std::endl;
+		status = 1;
+	}
+
+	// Cleanup
+	glDeleteBuffers((int)SceneFile::Section::COUNT, SSBO_scene);
+	glDeleteTextures(1, &tex_output);
+
+	return status;
+}
@@ -0,0 +1,97 @@
+#include "glad/glad.h"
+#include "HeadlessContext.h"
+
+#include <EGL/eglext.h>
+#include <iostream>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+HeadlessContext::HeadlessContext() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT) {
+}
+
+HeadlessContext::~HeadlessContext() {
+	if (display != EGL_NO_DISPLAY) {
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT) {
+			eglDestroyContext(display, context);
+		}
+		eglTerminate(display);
+	}
+}
+
+static EGLDisplay OpenDisplay() {
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) {
+		EGLDisplay dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, nullptr, nullptr)) {
+			return dpy;
+		}
+
+		PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+		EGLDeviceEXT device;
+		EGLint n_devices = 0;
+		if (queryDevices && queryDevices(1, &device, &n_devices) && n_devices > 0) {
+			dpy = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+			if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, nullptr, nullptr)) {
+				return dpy;
+			}
+		}
+	}
+
+	EGLDisplay dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, nullptr, nullptr)) {
+		return dpy;
+	}
+	return EGL_NO_DISPLAY;
+}
+
+bool HeadlessContext::Init(int major, int minor) {
+	display = OpenDisplay();
+	if (display == EGL_NO_DISPLAY) {
+		std::cerr << "ERR::EGL::NO_DISPLAY" << std::endl;
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cerr << "ERR::EGL::NO_OPENGL_API" << std::endl;
+		return false;
+	}
+
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint n_configs = 0;
+	if (!eglChooseConfig(display, config_attribs, &config, 1, &n_configs) || n_configs < 1) {
+		std::cerr << "ERR::EGL::NO_CONFIG" << std::endl;
+		return false;
+	}
+
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major,
+		EGL_CONTEXT_MINOR_VERSION, minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT) {
+		std::cerr << "ERR::EGL::CONTEXT_CREATE_FAIL" << std::endl;
+		return false;
+	}
+
+	// Needs EGL_KHR_surfaceless_context, which every headless capable driver exposes.
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		std::cerr << "ERR::EGL::MAKE_CURRENT_FAIL" << std::endl;
+		return false;
+	}
+
+	if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+		std::cerr << "ERR::GLAD::GL_LOADER_FAIL" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <EGL/egl.h>
+
+/*
+ * OpenGL core context without a window or display server.
+ * Prefers Mesa's surfaceless platform (works on llvmpipe), then the first EGL device, then the default display.
+ * Everything renders into FBOs/images, so no surface is ever created.
+ */
+class HeadlessContext
+{
+private:
+	EGLDisplay display;
+	EGLContext context;
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	// Creates the context, makes it current and loads GL through glad.
+	bool Init(int major = 4, int minor = 5);
+};
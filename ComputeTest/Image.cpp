@@ -0,0 +1,108 @@
+#include "Image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+	bool EndsWith(const std::string& s, const std::string& suffix) {
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	bool LittleEndian() {
+		const uint16_t one = 1;
+		return *(const uint8_t*)&one == 1;
+	}
+}
+
+bool Image::Write(const std::string& path, int width, int height, const std::vector<float>& rgba) {
+	return EndsWith(path, ".pfm") ? WritePFM(path, width, height, rgba) : WritePPM(path, width, height, rgba);
+}
+
+bool Image::WritePPM(const std::string& path, int width, int height, const std::vector<float>& rgba) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	file << "P6\n" << width << ' ' << height << "\n255\n";
+	std::vector<uint8_t> row(width * 3);
+	// GL images start at the bottom row, PPM at the top.
+	for (int j = height - 1; j >= 0; j--) {
+		for (int i = 0; i < width; i++) {
+			for (int c = 0; c < 3; c++) {
+				float v = std::min(std::max(rgba[(j * width + i) * 4 + c], 0.0f), 1.0f);
+				row[i * 3 + c] = (uint8_t)(v * 255.0f + 0.5f);
+			}
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+	return (bool)file;
+}
+
+bool Image::WritePFM(const std::string& path, int width, int height, const std::vector<float>& rgba) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	// A negative scale marks little endian data.
+	file << "PF\n" << width << ' ' << height << '\n' << (LittleEndian() ? "-1.0" : "1.0") << '\n';
+	std::vector<float> row(width * 3);
+	for (int j = 0; j < height; j++) {
+		for (int i = 0; i < width; i++) {
+			for (int c = 0; c < 3; c++) {
+				row[i * 3 + c] = rgba[(j * width + i) * 4 + c];
+			}
+		}
+		file.write((const char*)row.data(), row.size() * sizeof(float));
+	}
+	return (bool)file;
+}
+
+bool Image::Read(const std::string& path, int& width, int& height, std::vector<float>& rgba) {
+	std::ifstream file(path, std::ios::binary);
+	std::string magic;
+	double scale = 255.0;
+	file >> magic >> width >> height >> scale;
+	// Exactly one whitespace character ends the header.
+	file.get();
+	if (!file || (magic != "P6" && magic != "PF") || width <= 0 || height <= 0) {
+		std::cout << "ERR::IMAGE::READ_FAIL " << path << std::endl;
+		return false;
+	}
+
+	rgba.assign((size_t)width * height * 4, 1.0f);
+	if (magic == "PF") {
+		const bool swap = (scale < 0.0) != LittleEndian();
+		std::vector<float> row(width * 3);
+		for (int j = 0; j < height; j++) {
+			file.read((char*)row.data(), row.size() * sizeof(float));
+			for (int i = 0; i < width * 3; i++) {
+				float v = row[i];
+				if (swap) {
+					uint8_t b[4];
+					std::memcpy(b, &v, 4);
+					std::swap(b[0], b[3]);
+					std::swap(b[1], b[2]);
+					std::memcpy(&v, b, 4);
+				}
+				rgba[(j * width + i / 3) * 4 + i % 3] = v;
+			}
+		}
+	} else {
+		std::vector<uint8_t> row(width * 3);
+		for (int j = height - 1; j >= 0; j--) {
+			file.read((char*)row.data(), row.size());
+			for (int i = 0; i < width * 3; i++) {
+				rgba[(j * width + i / 3) * 4 + i % 3] = row[i] / (float)scale;
+			}
+		}
+	}
+	if (!file) {
+		std::cout << "ERR::IMAGE::TRUNCATED " << path << std::endl;
+		return false;
+	}
+	return true;
+}
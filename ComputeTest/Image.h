@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+ * RGBA float images as read back from the output texture, bottom row first, on disk.
+ * PPM is clamped and quantized to 8 bits for viewing. PFM keeps the radiance as is,
+ * for references and error measurements. PFM stores bottom row first too.
+ */
+namespace Image {
+	// PFM if `path` ends in .pfm, PPM otherwise.
+	bool Write(const std::string& path, int width, int height, const std::vector<float>& rgba);
+	// The way fDraw.frag shows it: clamped, no tonemapping.
+	bool WritePPM(const std::string& path, int width, int height, const std::vector<float>& rgba);
+	bool WritePFM(const std::string& path, int width, int height, const std::vector<float>& rgba);
+
+	// Binary PPM (P6, 8 bit) or colour PFM (PF), alpha set to 1. False, after printing why, on anything else.
+	bool Read(const std::string& path, int& width, int& height, std::vector<float>& rgba);
+}
@@ -0,0 +1,184 @@
+#include "Lights.h"
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+	const uint32_t PRIMITIVE_MASK = 0x0000FFFFu;
+	const uint32_t SECONDARY_MASK = 0xFFFF0000u;
+	const float PI = 3.14159265f;
+
+	bool Sampled(const Shape& s) {
+		const uint32_t primitive = s.shape_type & PRIMITIVE_MASK;
+		return (s.shape_type & SECONDARY_MASK) == 0
+			&& (primitive == static_cast<uint32_t>(ShapeType::SPHERE) || primitive == static_cast<uint32_t>(ShapeType::RECT))
+			&& s.D[0] + s.D[1] + s.D[2] > 0.0f;
+	}
+
+	float Luminance(const float* c) {
+		return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+	}
+
+	// What a light tree node bounds, before it is flattened.
+	struct Bounds {
+		Aabb box;
+		float power = 0.0f;
+		glm::vec3 axis = glm::vec3(0.0f, 0.0f, 1.0f);
+		float theta_o = 0.0f;	// normal cone half angle
+		float theta_e = 0.0f;	// emission past it
+		bool two_sided = false;
+	};
+
+	// Smallest cone around both, as in pbrt's DirectionCone::Union.
+	void ConeUnion(const Bounds& a, const Bounds& b, Bounds& out) {
+		if (b.theta_o > a.theta_o) {
+			ConeUnion(b, a, out);
+			return;
+		}
+		float theta_d = std::acos(glm::clamp(glm::dot(a.axis, b.axis), -1.0f, 1.0f));
+		if (std::min(theta_d + b.theta_o, PI) <= a.theta_o) {
+			out.axis = a.axis;
+			out.theta_o = a.theta_o;
+			return;
+		}
+		float theta_o = 0.5f * (a.theta_o + theta_d + b.theta_o);
+		glm::vec3 k = glm::cross(a.axis, b.axis);
+		if (theta_o >= PI || glm::dot(k, k) == 0.0f) {
+			out.axis = a.axis;
+			out.theta_o = PI;
+			return;
+		}
+		// a's axis turned towards b's, by Rodrigues' formula.
+		float theta_r = theta_o - a.theta_o;
+		k = glm::normalize(k);
+		out.axis = glm::normalize(a.axis * std::cos(theta_r) + glm::cross(k, a.axis) * std::sin(theta_r));
+		out.theta_o = theta_o;
+	}
+
+	Bounds Union(const Bounds& a, const Bounds& b) {
+		Bounds u;
+		u.box = a.box;
+		u.box.Grow(b.box);
+		u.power = a.power + b.power;
+		ConeUnion(a, b, u);
+		u.theta_e = std::max(a.theta_e, b.theta_e);
+		u.two_sided = a.two_sided || b.two_sided;
+		return u;
+	}
+
+	void Store(const Bounds& b, LightNode& n) {
+		for (int i = 0; i < 3; i++) {
+			n.lo[i] = b.box.bmin[i];
+			n.hi[i] = b.box.bmax[i];
+			n.axis[i] = b.axis[i];
+		}
+		n.power = b.power;
+		n.cos_o = std::cos(b.theta_o);
+		n.cos_e = std::cos(b.theta_e);
+		n.flags |= b.two_sided ? LightNode::TWO_SIDED : 0u;
+	}
+
+	// Median split on the widest axis of the centers. Halving keeps the depth within
+	// the 32 bits of a trail for any number of lights that fits a uint.
+	uint32_t Build(std::vector<LightNode>& tree, const std::vector<Bounds>& leaves,
+		uint32_t* idx, size_t n, uint32_t trail, uint32_t depth, Bounds& bounds) {
+		if (n == 1) {
+			tree[idx[0]].trail = trail;
+			bounds = leaves[idx[0]];
+			return idx[0];
+		}
+
+		Aabb centers;
+		for (size_t i = 0; i < n; i++) {
+			centers.Grow(leaves[idx[i]].box.Center());
+		}
+		glm::vec3 extent = centers.bmax - centers.bmin;
+		int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z) ? 1 : 2;
+		size_t mid = n / 2;
+		std::nth_element(idx, idx + mid, idx + n, [&leaves, axis](uint32_t a, uint32_t b) {
+			return leaves[a].box.Center()[axis] < leaves[b].box.Center()[axis];
+		});
+
+		uint32_t node = (uint32_t)tree.size();
+		tree.emplace_back();
+		Bounds left, right;
+		uint32_t l = Build(tree, leaves, idx, mid, trail, depth + 1, left);
+		uint32_t r = Build(tree, leaves, idx + mid, n - mid, trail | (1u << depth), depth + 1, right);
+		bounds = Union(left, right);
+		tree[node].left = l;
+		tree[node].right = r;
+		tree[node].flags = 0u;
+		Store(bounds, tree[node]);
+		return node;
+	}
+}
+
+size_t Lights::Tag(std::vector<Shape>& shapes) {
+	uint32_t n = 0;
+	for (Shape& s : shapes) {
+		s.light = Sampled(s) ? ++n : 0u;
+	}
+	return n;
+}
+
+Lights::Lights(const Shape* shapes, size_t count) : count(0), buffer(0) {
+	std::vector<Bounds> leaves;
+	for (size_t i = 0; i < count; i++) {
+		const Shape& s = shapes[i];
+		if (s.light == 0) continue;
+		if (tree.size() < s.light) {
+			tree.resize(s.light);
+			leaves.resize(s.light);
+		}
+
+		LightNode& n = tree[s.light - 1];
+		Bounds& b = leaves[s.light - 1];
+		std::memcpy(n.emit, s.D, sizeof(n.emit));
+		n.flags = LightNode::LEAF;
+		b.theta_e = 0.5f * PI;
+		if ((s.shape_type & PRIMITIVE_MASK) == static_cast<uint32_t>(ShapeType::RECT)) {
+			uint32_t axis;
+			std::memcpy(&axis, &s.rotation, sizeof(uint32_t));
+			glm::vec3 a(s.A[0], s.A[1], s.A[2]);
+			glm::vec3 c = a + glm::vec3(s.B[0], s.B[1], s.B[2]);
+			c[axis] = a[axis];	// B holds the normal's sign there
+			b.box = Aabb(glm::min(a, c), glm::max(a, c));
+			b.axis = glm::vec3(0.0f);
+			b.axis[axis] = 1.0f;
+			b.two_sided = true;
+			n.flags |= LightNode::RECT | (axis << LightNode::AXIS_SHIFT);
+			n.area = std::abs(s.B[(axis + 1) % 3] * s.B[(axis + 2) % 3]);
+		} else {
+			glm::vec3 c(s.A[0], s.A[1], s.A[2]);
+			b.box = Aabb(c - glm::vec3(s.B[0]), c + glm::vec3(s.B[0]));
+			b.theta_o = PI;
+			n.area = 4.0f * PI * s.B[0] * s.B[0];
+		}
+		// Emitted power up to a constant, both kinds radiate from every point of their area.
+		b.power = Luminance(n.emit) * n.area;
+		Store(b, n);
+	}
+	this->count = tree.size();
+
+	if (this->count > 1) {
+		std::vector<uint32_t> idx(this->count);
+		for (size_t i = 0; i < idx.size(); i++) {
+			idx[i] = (uint32_t)i;
+		}
+		tree.reserve(2 * this->count - 1);
+		Bounds root;
+		Build(tree, leaves, idx.data(), idx.size(), 0u, 0u, root);
+	}
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, tree.size() * sizeof(LightNode), tree.data(), GL_STATIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer);
+}
+
+Lights::~Lights() {
+	glDeleteBuffers(1, &buffer);
+}
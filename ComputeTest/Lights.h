@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "ShaderStructs.h"
+
+/*
+ * Light tree node, matches LightNode in raycompute.comp. Bounds where the lights are,
+ * how much they emit and in which directions: a cone of normals around `axis`, and
+ * how far past them light still leaves. The first nodes are the leaves, one per
+ * light in the order of their tags, then the root and the rest of the interior
+ * nodes, depth first.
+ */
+struct LightNode {
+	float lo[3];		// a sphere's bounds, a rect's corners
+	float power;		// luminance times area, summed
+	float hi[3];
+	float cos_o;		// half angle of the normal cone, -1 for all directions
+	float axis[3];
+	float cos_e;		// emission past the normals, 0 for surfaces lit a hemisphere around them
+	float emit[3];		// leaves only
+	uint32_t trail;		// leaves only, bit d set where the way down from the root goes right at depth d
+	uint32_t left;
+	uint32_t right;
+	uint32_t flags;
+	float area;			// leaves only
+
+	static const uint32_t LEAF = 1u;
+	static const uint32_t TWO_SIDED = 2u;	// emits around -axis as well
+	static const uint32_t RECT = 4u;		// else a sphere
+	static const uint32_t AXIS_SHIFT = 4u;	// a rect's normal, as in Shape::rotation
+};
+
+/*
+ * Emitters raycompute.comp samples directly, for next event estimation. Tag()
+ * marks them in the shapes themselves, so the tree survives whatever order
+ * the BVH builders, the GPU builder included, put objbuf in: a hit on a tagged
+ * shape knows which light it is, and a tree built from the sorted shapes
+ * is the same as one from the unsorted.
+ *
+ * A light is picked by walking down the tree, taking either child by how much it
+ * could light the point being shaded: its power over the squared distance, less
+ * where it faces away. Thousands of small lamps then cost a few steps per sample,
+ * and mostly the ones nearby are picked.
+ *
+ * Only plain emissive spheres and rects are tagged. Volumes, cuboids, meshes and
+ * instanced groups keep glowing, but are only found by the paths that hit them.
+ */
+class Lights
+{
+public:
+	static const GLuint BINDING = 15;
+
+	// Numbers the shapes that can be sampled and clears every other tag. Returns how many there are.
+	static size_t Tag(std::vector<Shape>& shapes);
+
+	// Tree over the tagged shapes among `count`, in any order, bound to BINDING.
+	// Without any the buffer is empty and the shader samples nothing.
+	Lights(const Shape* shapes, size_t count);
+	explicit Lights(const std::vector<Shape>& shapes) : Lights(shapes.data(), shapes.size()) {}
+	~Lights();
+
+	Lights(const Lights&) = delete;
+	Lights& operator=(const Lights&) = delete;
+
+	size_t Count() const { return count; }
+	const std::vector<LightNode>& Tree() const { return tree; }
+
+private:
+	size_t count;
+	std::vector<LightNode> tree;
+	GLuint buffer;
+};
@@ -0,0 +1,268 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+	// Axis aligned triangles have flat boxes, pad them like Bvh::ShapeBounds pads a Rect.
+	const float FLAT_PAD = 1e-4f;
+
+	// Appends polygon `face`, given as 0 based vertex indices, as a triangle fan.
+	bool AddFace(Mesh& mesh, const std::vector<int64_t>& face) {
+		for (size_t i = 2; i < face.size(); i++) {
+			for (int64_t v : { face[0], face[i - 1], face[i] }) {
+				if (v < 0 || v >= (int64_t)mesh.vertices.size()) {
+					return false;
+				}
+				mesh.indices.push_back((uint32_t)v);
+			}
+		}
+		return true;
+	}
+
+	enum class PlyFormat {
+		ASCII,
+		BINARY_LE,
+		BINARY_BE
+	};
+
+	struct PlyProperty {
+		std::string name;
+		std::string type;
+		std::string count_type;		// empty unless this is a list
+	};
+
+	struct PlyElement {
+		std::string name;
+		size_t count;
+		std::vector<PlyProperty> properties;
+	};
+
+	int PlySize(const std::string& type) {
+		if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+		if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+		if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32") return 4;
+		if (type == "double" || type == "float64") return 8;
+		return 0;
+	}
+
+	double PlyRead(std::istream& file, PlyFormat format, const std::string& type) {
+		if (format == PlyFormat::ASCII) {
+			double v = 0.0;
+			file >> v;
+			return v;
+		}
+
+		unsigned char bytes[8] = {};
+		int size = PlySize(type);
+		file.read((char*)bytes, size);
+		// PLY only knows the two byte orders, this assumes a little endian host.
+		if (format == PlyFormat::BINARY_BE) {
+			std::reverse(bytes, bytes + size);
+		}
+
+		if (type == "char" || type == "int8") { int8_t v; std::memcpy(&v, bytes, 1); return v; }
+		if (type == "uchar" || type == "uint8") { uint8_t v; std::memcpy(&v, bytes, 1); return v; }
+		if (type == "short" || type == "int16") { int16_t v; std::memcpy(&v, bytes, 2); return v; }
+		if (type == "ushort" || type == "uint16") { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+		if (type == "int" || type == "int32") { int32_t v; std::memcpy(&v, bytes, 4); return v; }
+		if (type == "uint" || type == "uint32") { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+		if (type == "float" || type == "float32") { float v; std::memcpy(&v, bytes, 4); return v; }
+		double v;
+		std::memcpy(&v, bytes, 8);
+		return v;
+	}
+}
+
+bool LoadObj(const std::string& path, Mesh& mesh) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERR::MESH::FILE_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+
+	mesh = Mesh();
+	std::string line;
+	std::vector<int64_t> face;
+	while (std::getline(file, line)) {
+		std::istringstream in(line);
+		std::string tag;
+		in >> tag;
+		if (tag == "v") {
+			glm::vec3 p;
+			in >> p.x >> p.y >> p.z;
+			mesh.vertices.push_back(p);
+		} else if (tag == "f") {
+			// Corners are v, v/vt, v//vn or v/vt/vn. Only the position matters here.
+			face.clear();
+			std::string corner;
+			while (in >> corner) {
+				int64_t v = std::atoll(corner.c_str());
+				face.push_back((v < 0) ? (int64_t)mesh.vertices.size() + v : v - 1);
+			}
+			if (!AddFace(mesh, face)) {
+				std::cout << "ERR::MESH::BAD_INDEX " << path << std::endl;
+				return false;
+			}
+		}
+	}
+	return !mesh.indices.empty();
+}
+
+bool LoadPly(const std::string& path, Mesh& mesh) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "ERR::MESH::FILE_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	std::getline(file, line);
+	if (line.compare(0, 3, "ply") != 0) {
+		std::cout << "ERR::MESH::NOT_A_PLY " << path << std::endl;
+		return false;
+	}
+
+	PlyFormat format = PlyFormat::ASCII;
+	std::vector<PlyElement> elements;
+	while (std::getline(file, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		std::istringstream in(line);
+		std::string tag;
+		in >> tag;
+		if (tag == "format") {
+			std::string name;
+			in >> name;
+			if (name == "binary_little_endian") {
+				format = PlyFormat::BINARY_LE;
+			} else if (name == "binary_big_endian") {
+				format = PlyFormat::BINARY_BE;
+			}
+		} else if (tag == "element") {
+			PlyElement e;
+			in >> e.name >> e.count;
+			elements.push_back(e);
+		} else if (tag == "property" && !elements.empty()) {
+			PlyProperty p;
+			in >> p.type;
+			if (p.type == "list") {
+				in >> p.count_type >> p.type;
+			}
+			in >> p.name;
+			if (PlySize(p.type) == 0 || (!p.count_type.empty() && PlySize(p.count_type) == 0)) {
+				std::cout << "ERR::MESH::PLY_TYPE " << p.type << std::endl;
+				return false;
+			}
+			elements.back().properties.push_back(p);
+		} else if (tag == "end_header") {
+			break;
+		}
+	}
+
+	mesh = Mesh();
+	std::vector<int64_t> face;
+	for (const PlyElement& e : elements) {
+		for (size_t item = 0; item < e.count; item++) {
+			glm::vec3 p(0.0f);
+			face.clear();
+			for (const PlyProperty& prop : e.properties) {
+				if (!prop.count_type.empty()) {
+					size_t n = (size_t)PlyRead(file, format, prop.count_type);
+					for (size_t i = 0; i < n; i++) {
+						double v = PlyRead(file, format, prop.type);
+						if (prop.name == "vertex_indices" || prop.name == "vertex_index") {
+							face.push_back((int64_t)v);
+						}
+					}
+				} else {
+					double v = PlyRead(file, format, prop.type);
+					if (prop.name == "x") p.x = (float)v;
+					else if (prop.name == "y") p.y = (float)v;
+					else if (prop.name == "z") p.z = (float)v;
+				}
+			}
+			if (!file) {
+				std::cout << "ERR::MESH::TRUNCATED " << path << std::endl;
+				return false;
+			}
+			if (e.name == "vertex") {
+				mesh.vertices.push_back(p);
+			} else if (e.name == "face" && !AddFace(mesh, face)) {
+				std::cout << "ERR::MESH::BAD_INDEX " << path << std::endl;
+				return false;
+			}
+		}
+	}
+	return !mesh.indices.empty();
+}
+
+bool LoadMesh(const std::string& path, Mesh& mesh) {
+	std::string ext = path.substr(path.find_last_of('.') + 1);
+	std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	if (ext == "obj") {
+		return LoadObj(path, mesh);
+	} else if (ext == "ply") {
+		return LoadPly(path, mesh);
+	}
+	std::cout << "ERR::MESH::UNKNOWN_FORMAT " << path << std::endl;
+	return false;
+}
+
+void FitMesh(Mesh& mesh, const glm::vec3& center, float size) {
+	Aabb box;
+	for (const glm::vec3& v : mesh.vertices) {
+		box.Grow(v);
+	}
+	if (box.Empty()) {
+		return;
+	}
+	glm::vec3 d = box.bmax - box.bmin;
+	glm::vec3 old_center = box.Center();
+	float scale = size / std::max(std::max(d.x, d.y), std::max(d.z, 1e-12f));
+	for (glm::vec3& v : mesh.vertices) {
+		v = center + (v - old_center) * scale;
+	}
+}
+
+Shape MeshPool::Add(const Mesh& mesh, const glm::vec3& col, float param, MaterialType type, const glm::vec3& emissive) {
+	const uint32_t vertex_base = (uint32_t)vertices.size();
+	const uint32_t triangle_base = (uint32_t)Triangles();
+	const uint32_t node_base = (uint32_t)nodes.size();
+
+	std::vector<Aabb> bounds(mesh.Triangles());
+	for (size_t t = 0; t < bounds.size(); t++) {
+		for (int c = 0; c < 3; c++) {
+			bounds[t].Grow(mesh.vertices[mesh.indices[3 * t + c]]);
+		}
+		bounds[t].bmin -= glm::vec3(FLAT_PAD);
+		bounds[t].bmax += glm::vec3(FLAT_PAD);
+	}
+
+	std::vector<uint32_t> order;
+	std::vector<BvhNode> tree = Bvh::Build(bounds, order);
+	if (tree.empty()) {
+		tree.push_back(Bvh::EmptyNode());
+	}
+	for (BvhNode& n : tree) {
+		n.offset += (n.count > 0) ? triangle_base : node_base;
+	}
+	nodes.insert(nodes.end(), tree.begin(), tree.end());
+
+	for (const glm::vec3& v : mesh.vertices) {
+		vertices.push_back(glm::vec4(v, 0.0f));
+	}
+	for (uint32_t t : order) {
+		for (int c = 0; c < 3; c++) {
+			indices.push_back(vertex_base + mesh.indices[3 * t + c]);
+		}
+	}
+
+	const BvhNode& root = tree[0];
+	return MeshShape(glm::vec3(root.bmin[0], root.bmin[1], root.bmin[2]), glm::vec3(root.bmax[0], root.bmax[1], root.bmax[2]), node_base, col, emissive, param, type);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "ShaderStructs.h"
+#include "Bvh.h"
+
+// Indexed triangle list, three indices per triangle, wound counter clockwise seen from outside.
+struct Mesh {
+	std::vector<glm::vec3> vertices;
+	std::vector<uint32_t> indices;
+
+	size_t Triangles() const {
+		return indices.size() / 3;
+	}
+};
+
+// Wavefront OBJ: positions and faces only, polygons are fanned into triangles.
+bool LoadObj(const std::string& path, Mesh& mesh);
+
+// Stanford PLY, ascii or binary little endian, vertex x/y/z and face vertex lists.
+bool LoadPly(const std::string& path, Mesh& mesh);
+
+// Picks the loader by extension.
+bool LoadMesh(const std::string& path, Mesh& mesh);
+
+// Scales and moves the mesh so its largest side is `size` and its bounds are centered on `center`.
+void FitMesh(Mesh& mesh, const glm::vec3& center, float size);
+
+/*
+ * Triangles of every mesh in the scene, laid out for meshbvhbuf, vertexbuf and
+ * indexbuf in raycompute.comp. Each mesh gets its own BVH over its triangles,
+ * rebased into the shared node array like TwoLevelBvh does for groups, and is
+ * placed in the scene by the MeshShape Add() returns. That shape can go into any
+ * scene or group like a Sphere would.
+ */
+class MeshPool
+{
+private:
+	std::vector<glm::vec4> vertices;	// w unused, keeps the std430 stride explicit
+	std::vector<uint32_t> indices;
+	std::vector<BvhNode> nodes;
+
+public:
+	Shape Add(const Mesh& mesh, const glm::vec3& col, float param, MaterialType type, const glm::vec3& emissive = glm::vec3(0.0f));
+
+	const std::vector<glm::vec4>& Vertices() const {
+		return vertices;
+	}
+
+	const std::vector<uint32_t>& Indices() const {
+		return indices;
+	}
+
+	const std::vector<BvhNode>& Nodes() const {
+		return nodes;
+	}
+
+	size_t Triangles() const {
+		return indices.size() / 3;
+	}
+};
@@ -0,0 +1,158 @@
+#include "ProgramCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "SceneFile.h"
+
+namespace {
+
+	const char MAGIC[8] = { 'T', 'R', 'A', 'C', 'E', 'R', 'P', 'B' };
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t format;
+		uint64_t key;
+		uint64_t bytes;
+	};
+
+	std::string directory;
+	ProgramCache::Stats stats;
+
+	double Milliseconds(std::chrono::steady_clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	uint64_t Key(const std::string& source) {
+		SceneHash hash;
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+			const char* s = (const char*)glGetString(name);
+			if (s) hash.Add(s, std::strlen(s) + 1);
+		}
+		hash.Add(source.data(), source.size());
+		return hash.Value();
+	}
+
+	std::string Path(uint64_t key) {
+		std::stringstream name;
+		name << directory << '/' << std::hex << std::setw(16) << std::setfill('0') << key << ".program";
+		return name.str();
+	}
+
+	// 0 if the file is missing or the driver will not take the binary.
+	GLuint Load(const std::string& path, uint64_t key) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return 0;
+		}
+		Header header;
+		if (!file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+			|| header.version != ProgramCache::VERSION || header.key != key) {
+			return 0;
+		}
+		std::vector<char> binary(header.bytes);
+		if (!file.read(binary.data(), binary.size())) {
+			return 0;
+		}
+
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+
+	void Store(GLuint program, const std::string& path, uint64_t key) {
+		GLint linked = GL_FALSE, length = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (!linked || length <= 0) {
+			return;
+		}
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, binary.data());
+
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+
+		Header header;
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = ProgramCache::VERSION;
+		header.format = format;
+		header.key = key;
+		header.bytes = (uint64_t)length;
+
+		// Through a temporary file like the scene cache, another process may be loading it.
+		std::string temp = path + ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(header));
+			file.write(binary.data(), length);
+			if (!file) {
+				std::cout << "ERR::PROGRAM_CACHE::WRITE_FAIL " << path << std::endl;
+				file.close();
+				std::remove(temp.c_str());
+				return;
+			}
+		}
+		if (std::rename(temp.c_str(), path.c_str()) != 0) {
+			std::remove(path.c_str());
+			if (std::rename(temp.c_str(), path.c_str()) != 0) {
+				std::remove(temp.c_str());
+			}
+		}
+	}
+}
+
+void ProgramCache::SetDirectory(const std::string& dir) {
+	directory = dir;
+}
+
+const std::string& ProgramCache::Directory() {
+	return directory;
+}
+
+GLuint ProgramCache::Get(const std::string& source, const std::function<GLuint()>& compile) {
+	stats.programs++;
+
+	uint64_t key = 0;
+	std::string path;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (!directory.empty() && formats > 0) {
+		auto start = std::chrono::steady_clock::now();
+		key = Key(source);
+		path = Path(key);
+		GLuint program = Load(path, key);
+		stats.load_ms += Milliseconds(start);
+		if (program) {
+			stats.hits++;
+			return program;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	GLuint program = compile();
+	stats.compile_ms += Milliseconds(start);
+	if (!path.empty()) {
+		Store(program, path, key);
+	}
+	return program;
+}
+
+const ProgramCache::Stats& ProgramCache::Statistics() {
+	return stats;
+}
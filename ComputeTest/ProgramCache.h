@@ -0,0 +1,37 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+/*
+ * On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+ * Entries are keyed on a hash of the full program source, defines included, and
+ * the GL vendor, renderer and version strings, so a driver update or an edited
+ * shader is a miss. Anything unexpected, a missing directory, a truncated file or
+ * a binary the driver rejects, falls back to compiling from source.
+ * Disabled until a directory is set.
+ */
+namespace ProgramCache {
+	const uint32_t VERSION = 1;
+
+	struct Stats {
+		int programs = 0;		// linked through Get
+		int hits = 0;			// of those, loaded from a binary
+		double load_ms = 0.0;	// spent loading binaries, hits and rejected ones
+		double compile_ms = 0.0;	// spent compiling and linking from source
+	};
+
+	// Empty disables the cache, a missing directory is created on the first store.
+	void SetDirectory(const std::string& dir);
+	const std::string& Directory();
+
+	// The program for `source`, from the cache if possible, else from `compile`, which
+	// returns a linked program. Successfully linked programs are stored for next time.
+	GLuint Get(const std::string& source, const std::function<GLuint()>& compile);
+
+	// Totals since startup, for reporting cold against warm startup.
+	const Stats& Statistics();
+}
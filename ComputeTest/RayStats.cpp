@@ -0,0 +1,68 @@
+#include "RayStats.h"
+
+#include <vector>
+
+namespace {
+
+	double Ratio(uint64_t n, uint64_t d) {
+		return (d > 0) ? (double)n / d : 0.0;
+	}
+}
+
+RayStats::RayStats() : buffer(0) {
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, COUNT * sizeof(GLuint), nullptr, GL_DYNAMIC_READ);
+	const GLuint zero = 0;
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer);
+}
+
+RayStats::~RayStats() {
+	glDeleteBuffers(1, &buffer);
+}
+
+RayStats::Counts RayStats::Read() {
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	std::vector<GLuint> raw(COUNT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, COUNT * sizeof(GLuint), raw.data());
+	const GLuint zero = 0;
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	Counts counts;
+	for (int i = 0; i < COUNT; i++) {
+		counts[i] = raw[i];
+	}
+	return counts;
+}
+
+void RayStats::PrintLine(std::ostream& out, const Counts& counts) {
+	const std::streamsize precision = out.precision(3);
+	out << counts[PRIMARY] << " paths, " << counts[RAYS] << " rays, "
+		<< Ratio(counts[RAYS], counts[PRIMARY]) << " per path, ended "
+		<< counts[ESCAPED] << " escaped " << counts[ABSORBED] << " absorbed " << counts[TRUNCATED] << " truncated";
+	out.precision(precision);
+}
+
+void RayStats::Print(std::ostream& out, const Counts& counts) {
+	const uint64_t rays = counts[RAYS];
+	out << "Paths:            " << counts[PRIMARY] << std::endl;
+	out << "Rays:             " << rays << " (" << Ratio(rays, counts[PRIMARY]) << " per path)" << std::endl;
+	out << "Shadow rays:      " << counts[SHADOW_RAYS] << " (" << Ratio(counts[SHADOW_RAYS], counts[PRIMARY]) << " per path)" << std::endl;
+	out << "Ended:            " << counts[ESCAPED] << " escaped, " << counts[ABSORBED] << " absorbed, " << counts[TRUNCATED] << " truncated" << std::endl;
+	out << "Shape tests:      " << counts[SPHERE_TESTS] << " sphere, " << counts[CUBOID_TESTS] << " cuboid, "
+		<< counts[RECT_TESTS] << " rect, " << counts[MESH_TESTS] << " mesh ("
+		<< Ratio(counts[SPHERE_TESTS] + counts[CUBOID_TESTS] + counts[RECT_TESTS] + counts[MESH_TESTS], rays + counts[SHADOW_RAYS]) << " per ray)" << std::endl;
+	out << "Volume scatters:  " << counts[VOLUME_SCATTERS] << std::endl;
+	// With REJECTION_SAMPLING, uniform in the cube, the sphere takes 6/pi = 1.91 tries on average and the disk 4/pi = 1.27.
+	out << "Rejection tries:  " << counts[SPHERE_TRIES] << " sphere, " << counts[DISK_TRIES] << " disk" << std::endl;
+	out << "Dimensions:       " << counts[DIMENSIONS] << " (" << Ratio(counts[DIMENSIONS], counts[PRIMARY]) << " per path)" << std::endl;
+	out << "Rays per bounce: ";
+	int last = DEPTHS - 1;
+	while (last > 0 && counts[DEPTH + last] == 0) last--;
+	for (int d = 0; d <= last; d++) {
+		out << ' ' << counts[DEPTH + d];
+	}
+	out << std::endl;
+}
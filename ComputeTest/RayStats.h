@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <glad/glad.h>
+
+/*
+ * Workload counters of an instrumented raycompute.comp, both megakernel and
+ * wavefront: rays per bounce, shadow rays, HitShape calls per shape type, how
+ * paths end, how many random numbers they draw and how often the sphere and disk
+ * samplers in random.glsl go round. Programs
+ * built with Defines() count into a buffer at BINDING, Read() fetches and clears
+ * it. The atomics cost real time, so the counters are for comparing workloads,
+ * not speed.
+ */
+class RayStats
+{
+public:
+	// Same order as the RS_ defines in raycompute.comp.
+	enum Counter {
+		PRIMARY,			// camera rays
+		RAYS,				// WorldHit calls, camera rays included
+		ESCAPED,			// paths ended in the sky
+		ABSORBED,			// paths ended by Scatter
+		TRUNCATED,			// paths ended at MAX_DEPTH
+		SPHERE_TESTS,
+		CUBOID_TESTS,
+		RECT_TESTS,
+		MESH_TESTS,
+		VOLUME_SCATTERS,
+		SPHERE_TRIES,		// RandomInUnitSphere loop iterations, one per call without REJECTION_SAMPLING
+		DISK_TRIES,			// RandomInUnitDisk loop iterations, likewise
+		SHADOW_RAYS,		// light samples traced, not in RAYS
+		DIMENSIONS,			// rng() calls
+		DEPTH,				// DEPTHS entries, rays traced per bounce, the last also counts deeper ones
+		DEPTHS = 32,
+		COUNT = DEPTH + DEPTHS
+	};
+
+	using Counts = std::array<uint64_t, COUNT>;
+
+	static const GLuint BINDING = 14;
+
+	// For the defines of every program that should count.
+	static std::string Defines() {
+		return "#define RAY_STATS\n";
+	}
+
+	// Binds the buffer to BINDING, zeroed.
+	RayStats();
+	~RayStats();
+
+	RayStats(const RayStats&) = delete;
+	RayStats& operator=(const RayStats&) = delete;
+
+	// Everything counted since the last Read. Waits for the GPU. The counters are
+	// 32 bit on the device, so read at least once per frame.
+	Counts Read();
+
+	// One line: rays, bounces per path and how paths ended.
+	static void PrintLine(std::ostream& out, const Counts& counts);
+	// Every counter, with shape tests and loop iterations per ray.
+	static void Print(std::ostream& out, const Counts& counts);
+
+private:
+	GLuint buffer;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "ShaderStructs.h"
+
+/*
+ * Feature set raycompute.comp is specialized for. Every feature a scene does not
+ * use is compiled out through the HAS_* defines, so it costs neither branches nor
+ * registers, and MAX_DEPTH becomes a compile time bound. Lambertian materials are
+ * always in, they are also the fallback for anything compiled out. NEE samples the
+ * shapes Lights tagged at every diffuse bounce; off, paths only find lights by hitting them.
+ */
+struct RayVariant {
+	bool metal = true;
+	bool dielectric = true;
+	bool volume = true;
+	bool sphere = true;
+	bool cuboid = true;
+	bool rect = true;
+	bool mesh = true;
+	bool instances = true;
+	bool skybox = true;
+	bool nee = true;
+	int max_depth = 25;
+
+	// Everything the scene uses and nothing else.
+	static RayVariant ForScene(const Shape* shapes, size_t count, bool instances, bool skybox) {
+		RayVariant v;
+		v.metal = v.dielectric = v.volume = false;
+		v.sphere = v.cuboid = v.rect = v.mesh = false;
+		v.nee = false;
+		for (size_t i = 0; i < count; i++) {
+			const uint32_t shape = shapes[i].shape_type;
+			const uint32_t material = shapes[i].mat_type;
+			v.metal |= material == static_cast<uint32_t>(MaterialType::METALLIC);
+			v.dielectric |= material == static_cast<uint32_t>(MaterialType::DIELECTRIC);
+			v.volume |= material == static_cast<uint32_t>(MaterialType::ISOTROPIC)
+				|| (shape & static_cast<uint32_t>(ShapeType::ISOTROPIC)) == static_cast<uint32_t>(ShapeType::ISOTROPIC);
+			v.nee |= shapes[i].light != 0;
+			switch (shape & 0x0000FFFFu) {
+			case static_cast<uint32_t>(ShapeType::CUBOID): v.cuboid = true; break;
+			case static_cast<uint32_t>(ShapeType::RECT): v.rect = true; break;
+			case static_cast<uint32_t>(ShapeType::MESH): v.mesh = true; break;
+			default: v.sphere = true; break;
+			}
+		}
+		v.instances = instances;
+		v.skybox = skybox;
+		return v;
+	}
+
+	static RayVariant ForScene(const std::vector<Shape>& shapes, bool instances, bool skybox) {
+		return ForScene(shapes.data(), shapes.size(), instances, skybox);
+	}
+
+	// Preamble for Shader<ShaderType::COMPUTE>, after the tile's.
+	std::string Defines() const {
+		return "#define MAX_DEPTH " + std::to_string(max_depth) + "\n"
+			+ "#define HAS_METAL " + std::to_string((int)metal) + "\n"
+			+ "#define HAS_DIELECTRIC " + std::to_string((int)dielectric) + "\n"
+			+ "#define HAS_VOLUME " + std::to_string((int)volume) + "\n"
+			+ "#define HAS_SPHERE " + std::to_string((int)sphere) + "\n"
+			+ "#define HAS_CUBOID " + std::to_string((int)cuboid) + "\n"
+			+ "#define HAS_RECT " + std::to_string((int)rect) + "\n"
+			+ "#define HAS_MESH " + std::to_string((int)mesh) + "\n"
+			+ "#define HAS_INSTANCES " + std::to_string((int)instances) + "\n"
+			+ "#define HAS_SKYBOX " + std::to_string((int)skybox) + "\n"
+			+ "#define NEE " + std::to_string((int)nee) + "\n";
+	}
+
+	// Short description for logs, e.g. "metal dielectric sphere rect depth 25".
+	std::string Name() const {
+		std::string name;
+		const std::pair<bool, const char*> features[] = {
+			{ metal, "metal" }, { dielectric, "dielectric" }, { volume, "volume" }, { sphere, "sphere" }, { cuboid, "cuboid" },
+			{ rect, "rect" }, { mesh, "mesh" }, { instances, "instances" }, { skybox, "skybox" }, { nee, "nee" }
+		};
+		for (const auto& f : features) {
+			if (f.first) {
+				name += f.second;
+				name += ' ';
+			}
+		}
+		return name + "depth " + std::to_string(max_depth);
+	}
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+/*
+ * Where raycompute.comp's random numbers come from, see random.glsl. Picked at
+ * compile time through SAMPLER, so every Sampler needs its own program.
+ */
+struct Sampler {
+	const char* name;
+	int id;				// SAMPLER_* in random.glsl
+	bool blue_noise;	// reads a BlueNoise mask, which must be bound
+
+	// Preamble for Shader<ShaderType::COMPUTE>.
+	std::string Defines() const {
+		return "#define SAMPLER " + std::to_string(id) + "\n";
+	}
+};
+
+// Plain Monte Carlo first, the default.
+const Sampler SAMPLERS[] = {
+	{ "random", 0, false },
+	{ "sobol", 1, false },
+	{ "bluenoise", 2, true }
+};
+const int N_SAMPLERS = sizeof(SAMPLERS) / sizeof(SAMPLERS[0]);
+
+// Returns the sampler called `name`, or nullptr.
+inline const Sampler* FindSampler(const std::string& name) {
+	for (const Sampler& s : SAMPLERS) {
+		if (name == s.name) {
+			return &s;
+		}
+	}
+	return nullptr;
+}
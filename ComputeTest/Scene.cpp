@@ -0,0 +1,140 @@
+#include "Scene.h"
+#include "Lights.h"
+
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+std::vector<Shape> CornellScene() {
+	std::vector<Shape> obj{
+		(Rect(glm::vec3{-3,-3,-2}, glm::vec3(6,6,0), glm::vec3(0.73f), 1.0f, MaterialType::LAMBERTIAN)),
+		(Rect(glm::vec3(-3,-3,-2), glm::vec3(0,6,6), glm::vec3(0.65f, 0.05f, 0.05f), 1.0f, MaterialType::LAMBERTIAN)),
+		(Rect(glm::vec3(3,-3,-2), glm::vec3(0,6,6), glm::vec3(0.12f, 0.45f, 0.15f), 1.0f, MaterialType::LAMBERTIAN, -1.0f)),
+		(Rect(glm::vec3(-3,-3,-2), glm::vec3(6,0,6), glm::vec3(0.8f, 0.8f, 0.8f), 1.0f, MaterialType::LAMBERTIAN, 1.0f)),
+		(Rect(glm::vec3(-3, 3,-2), glm::vec3(6,0,6), glm::vec3(0.8f, 0.8f, 0.8f), 1.0f, MaterialType::LAMBERTIAN, -1.0f)),
+		(Rect(glm::vec3(-2.0f, 2.99f,-1.0f), glm::vec3(4,0,4), glm::vec3(0.8f, 0.8f, 0.8f), glm::vec3(2.0f), 1.0f, MaterialType::LAMBERTIAN, -1.0f)),
+		(Cuboid(glm::vec3(-2.5, -3, -1), glm::vec3(2,4,2), 20.0f, glm::vec3(0.8f), 0.1f, MaterialType::LAMBERTIAN)),
+		(Volume<Cuboid>(0.4f, glm::vec3(0.0f, -2.99, 1), glm::vec3(2,2,2), -30.0f, glm::vec3(1.0f), 0.0f, MaterialType::ISOTROPIC)),
+		(Sphere(glm::vec3(-2.5f, 1.5f, -1.0f), 0.5f, glm::vec3(1.0f), 1.5f, MaterialType::DIELECTRIC)),
+		(Volume<Sphere>(0.7f, glm::vec3(-2.5f, 1.5f, -1.0f), 0.49f, glm::vec3(0.1f, 0.1f, 0.9f), 0.1f, MaterialType::ISOTROPIC))
+	};
+
+	return obj;
+}
+
+std::vector<Shape> SphereField(unsigned seed) {
+	std::vector<Shape> obj{
+		(Sphere(glm::vec3(0.0f, -100.5f, 0.0f), 100.0f, glm::vec3(0.5f), 1.0f, MaterialType::LAMBERTIAN)),
+		(Sphere(glm::vec3(0.0f, 0.0f, 0.0f), 0.5f, glm::vec3(0.1f, 0.2f, 0.5f), 1.0f, MaterialType::LAMBERTIAN)),
+		(Sphere(glm::vec3(1.0f, 0.0f, 0.0f), 0.5f, glm::vec3(0.8f, 0.6f, 0.2f), 0.5f, MaterialType::METALLIC)),
+		(Sphere(glm::vec3(-1.0f, 0.0f, 0.0f), 0.5f, glm::vec3(1.0f), 1.5f, MaterialType::DIELECTRIC)),
+		(Rect(glm::vec3(-6, 4, -6), glm::vec3(12, 0, 12), glm::vec3(0.8f), glm::vec3(1.5f), 1.0f, MaterialType::LAMBERTIAN, -1.0f))
+	};
+
+	std::default_random_engine rng(seed);
+	std::uniform_real_distribution<float> u(0.0f, 1.0f);
+	for (int i = -5; i < 6; i++) {
+		for (int j = -5; j < 6; j++) {
+			// Room for the three large balls.
+			if (i * i < 4 && j * j < 1) continue;
+			glm::vec3 p(i + u(rng) * 0.5f - 0.25f, -0.25f, j + u(rng) * 0.5f - 0.25f);
+			if (u(rng) > 0.1f) {
+				glm::vec3 c(0.8f * u(rng), 0.8f * u(rng), 0.8f * u(rng));
+				obj.push_back(Sphere(p, 0.25f, c, u(rng) * 0.7f + 0.3f, (u(rng) < 0.5f) ? MaterialType::LAMBERTIAN : MaterialType::METALLIC));
+			} else {
+				obj.push_back(Sphere(p, 0.25f, glm::vec3(1.0f), 1.4f, MaterialType::DIELECTRIC));
+			}
+		}
+	}
+	return obj;
+}
+
+std::vector<Shape> FogBox() {
+	std::vector<Shape> obj = CornellScene();
+	// Only the walls and the lamp, then volumes throughout.
+	obj.resize(6);
+	obj.push_back(Volume<Sphere>(0.15f, glm::vec3(0.0f, 0.0f, 0.5f), 2.5f, glm::vec3(0.9f), 0.0f, MaterialType::ISOTROPIC));
+	obj.push_back(Volume<Cuboid>(1.5f, glm::vec3(-2.5f, -3.0f, -1.0f), glm::vec3(2, 3, 2), 20.0f, glm::vec3(0.8f), 0.0f, MaterialType::ISOTROPIC));
+	obj.push_back(Volume<Cuboid>(0.4f, glm::vec3(0.5f, -2.99f, 0.5f), glm::vec3(2, 2, 2), -30.0f, glm::vec3(1.0f), 0.0f, MaterialType::ISOTROPIC));
+	obj.push_back(Sphere(glm::vec3(1.5f, 1.0f, 0.0f), 0.8f, glm::vec3(1.0f), 1.5f, MaterialType::DIELECTRIC));
+	obj.push_back(Volume<Sphere>(0.7f, glm::vec3(1.5f, 1.0f, 0.0f), 0.79f, glm::vec3(0.9f, 0.4f, 0.1f), 0.1f, MaterialType::ISOTROPIC));
+	obj.push_back(Volume<Sphere>(3.0f, glm::vec3(-1.0f, 1.5f, 1.5f), 0.6f, glm::vec3(0.1f, 0.1f, 0.9f), 0.1f, MaterialType::ISOTROPIC));
+	return obj;
+}
+
+std::vector<Shape> LampCloud(int count, unsigned seed) {
+	std::vector<Shape> obj = CornellScene();
+	// Everything but the lamp.
+	obj.erase(obj.begin() + 5);
+
+	std::default_random_engine rng(seed);
+	std::uniform_real_distribution<float> x(-2.8f, 2.8f);
+	std::uniform_real_distribution<float> y(1.0f, 2.8f);
+	std::uniform_real_distribution<float> z(-1.8f, 3.8f);
+	std::uniform_real_distribution<float> col(0.2f, 1.0f);
+
+	// As bright as the lamp altogether, 16 square units at 2.
+	const float radius = 0.04f;
+	const float emit = 2.0f * 16.0f / (std::max(count, 1) * 4.0f * 3.14159265f * radius * radius);
+	for (int i = 0; i < count; i++) {
+		glm::vec3 p(x(rng), y(rng), z(rng));
+		glm::vec3 c(col(rng), col(rng), col(rng));
+		obj.push_back(Sphere(p, radius, glm::vec3(0.8f), emit * c / (0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b), 1.0f, MaterialType::LAMBERTIAN));
+	}
+	return obj;
+}
+
+std::vector<Shape> SphereCloud(int count, float extent, unsigned seed) {
+	std::default_random_engine rng(seed);
+	std::uniform_real_distribution<float> pos(-extent, extent);
+	std::uniform_real_distribution<float> col(0.1f, 0.9f);
+
+	// Radius shrinks with the count so the cloud keeps roughly the same density.
+	float radius = extent * 0.5f / std::cbrt((float)std::max(count, 1));
+
+	std::vector<Shape> obj;
+	obj.reserve(count);
+	for (int i = 0; i < count; i++) {
+		glm::vec3 p(pos(rng), pos(rng), pos(rng));
+		glm::vec3 c(col(rng), col(rng), col(rng));
+		obj.push_back(Sphere(p, radius, c, 1.0f, MaterialType::LAMBERTIAN));
+	}
+	return obj;
+}
+
+TwoLevelBvh InstancedField(int count, unsigned seed) {
+	std::vector<Shape> ground{
+		(Rect(glm::vec3(-40, -3, -60), glm::vec3(80, 0, 80), glm::vec3(0.73f), 1.0f, MaterialType::LAMBERTIAN, 1.0f)),
+		(Rect(glm::vec3(-10, 6, -24), glm::vec3(20, 0, 32), glm::vec3(0.8f), glm::vec3(1.5f), 1.0f, MaterialType::LAMBERTIAN, -1.0f))
+	};
+	// Only the scene's own shapes can be lights, instanced ones are everywhere at once.
+	Lights::Tag(ground);
+	TwoLevelBvh scene(ground);
+
+	// Both groups stand on y = 0 inside a unit footprint.
+	uint32_t ball = scene.AddGroup({
+		(Sphere(glm::vec3(0.0f, 0.5f, 0.0f), 0.5f, glm::vec3(1.0f), 1.5f, MaterialType::DIELECTRIC)),
+		(Volume<Sphere>(2.0f, glm::vec3(0.0f, 0.5f, 0.0f), 0.49f, glm::vec3(0.1f, 0.1f, 0.9f), 0.1f, MaterialType::ISOTROPIC))
+	});
+	uint32_t block = scene.AddGroup({
+		(Cuboid(glm::vec3(-0.3f, 0.0f, -0.3f), glm::vec3(0.6f, 0.6f, 0.6f), glm::vec3(0.65f, 0.05f, 0.05f), 0.1f, MaterialType::LAMBERTIAN)),
+		(Sphere(glm::vec3(0.0f, 0.8f, 0.0f), 0.2f, glm::vec3(0.8f, 0.6f, 0.2f), 0.3f, MaterialType::METALLIC))
+	});
+
+	std::default_random_engine rng(seed);
+	std::uniform_real_distribution<float> yaw(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> jitter(0.8f, 1.2f);
+
+	// Square grid on the floor, from just in front of the camera's focus back into the distance.
+	const int side = std::max(1, (int)std::ceil(std::sqrt((float)count)));
+	const float cell = 16.0f / side;
+	for (int i = 0; i < count; i++) {
+		glm::vec3 p(-8.0f + cell * (i % side + 0.5f), -3.0f, 4.0f - 1.5f * cell * (i / side + 0.5f));
+		glm::mat4 m = glm::translate(glm::mat4(1.0f), p);
+		m = glm::rotate(m, yaw(rng), glm::vec3(0, 1, 0));
+		m = glm::scale(m, glm::vec3(cell * 0.8f * jitter(rng)));
+		scene.AddInstance((i & 1) ? block : ball, m);
+	}
+	scene.Build();
+	return scene;
+}
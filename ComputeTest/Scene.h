@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <random>
+
+#include "ShaderStructs.h"
+#include "TwoLevelBvh.h"
+
+// Cornell box lit by a single area lamp, with a rotated block, a smoke cube and a glass ball holding blue fog.
+std::vector<Shape> CornellScene();
+
+// Small lambert, metal and glass balls on a grid around three large ones, on a huge ground sphere under a wide lamp.
+std::vector<Shape> SphereField(unsigned seed = 1);
+
+// The Cornell box's walls and lamp filled with overlapping fog: a thin ball over most of the box,
+// smoke blocks, a glass ball holding orange fog and a dense blue one. Most bounces scatter in a volume.
+std::vector<Shape> FogBox();
+
+// The Cornell box lit by `count` small glowing balls of random colors under its ceiling instead of
+// the lamp, as bright as it altogether.
+std::vector<Shape> LampCloud(int count, unsigned seed = 1);
+
+// `count` small diffuse spheres scattered uniformly through a cube of half size `extent`.
+std::vector<Shape> SphereCloud(int count, float extent = 3.0f, unsigned seed = 1);
+
+// Floor under a wide lamp, covered by `count` instances of two groups: a glass ball holding blue fog
+// and a block carrying a metal ball. Each instance gets its own yaw and scale.
+TwoLevelBvh InstancedField(int count, unsigned seed = 1);
@@ -0,0 +1,201 @@
+#include "SceneFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	const char MAGIC[8] = { 'T', 'R', 'A', 'C', 'E', 'R', 'S', 'C' };
+	const int SECTIONS = (int)SceneFile::Section::COUNT;
+
+	uint64_t Align(uint64_t offset) {
+		return (offset + SceneFile::ALIGNMENT - 1) / SceneFile::ALIGNMENT * SceneFile::ALIGNMENT;
+	}
+}
+
+SceneFile::View SceneData::Get(SceneFile::Section s) const {
+	switch (s) {
+	case SceneFile::Section::SHAPES: return { shapes.data(), shapes.size() * sizeof(Shape) };
+	case SceneFile::Section::BVH: return { nodes.data(), nodes.size() * sizeof(BvhNode) };
+	case SceneFile::Section::TOP: return { top.data(), top.size() * sizeof(BvhNode) };
+	case SceneFile::Section::INSTANCES: return { instances.data(), instances.size() * sizeof(BvhInstance) };
+	case SceneFile::Section::MESH_BVH: return { mesh_nodes.data(), mesh_nodes.size() * sizeof(BvhNode) };
+	case SceneFile::Section::VERTICES: return { vertices.data(), vertices.size() * sizeof(glm::vec4) };
+	case SceneFile::Section::INDICES: return { indices.data(), indices.size() * sizeof(uint32_t) };
+	default: return { nullptr, 0 };
+	}
+}
+
+SceneHash::SceneHash() : value(14695981039346656037ull) {
+}
+
+void SceneHash::Add(const void* data, size_t bytes) {
+	const uint8_t* p = (const uint8_t*)data;
+	for (size_t i = 0; i < bytes; i++) {
+		value = (value ^ p[i]) * 1099511628211ull;
+	}
+}
+
+bool SceneHash::AddFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	std::vector<char> chunk(1 << 20);
+	while (file) {
+		file.read(chunk.data(), chunk.size());
+		Add(chunk.data(), (size_t)file.gcount());
+	}
+	return true;
+}
+
+bool WriteSceneFile(const std::string& path, uint64_t source_hash, const SceneData& scene) {
+	SceneFile::Header header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = SceneFile::VERSION;
+	header.sections = SECTIONS;
+	header.source_hash = source_hash;
+
+	SceneFile::SectionEntry table[SECTIONS];
+	uint64_t offset = Align(sizeof(header) + sizeof(table));
+	for (int s = 0; s < SECTIONS; s++) {
+		table[s].offset = offset;
+		table[s].bytes = scene.Get((SceneFile::Section)s).bytes;
+		offset = Align(offset + table[s].bytes);
+	}
+	header.file_bytes = offset;
+
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cout << "ERR::SCENE_FILE::WRITE_FAIL " << path << std::endl;
+			return false;
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)table, sizeof(table));
+		const char zeros[SceneFile::ALIGNMENT] = {};
+		uint64_t written = sizeof(header) + sizeof(table);
+		for (int s = 0; s < SECTIONS; s++) {
+			file.write(zeros, table[s].offset - written);
+			file.write((const char*)scene.Get((SceneFile::Section)s).data, table[s].bytes);
+			written = table[s].offset + table[s].bytes;
+		}
+		file.write(zeros, header.file_bytes - written);
+		if (!file) {
+			std::cout << "ERR::SCENE_FILE::WRITE_FAIL " << path << std::endl;
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+
+	// Windows will not rename over an existing file. If another job won the race, its file is just as good.
+	if (std::rename(temp.c_str(), path.c_str()) != 0) {
+		std::remove(path.c_str());
+		if (std::rename(temp.c_str(), path.c_str()) != 0) {
+			std::remove(temp.c_str());
+		}
+	}
+	return true;
+}
+
+MappedScene::MappedScene() :
+	base(nullptr),
+	size(0),
+#ifdef _WIN32
+	file(INVALID_HANDLE_VALUE),
+	mapping(nullptr) {
+#else
+	file(-1) {
+#endif
+}
+
+MappedScene::~MappedScene() {
+	Close();
+}
+
+void MappedScene::Close() {
+#ifdef _WIN32
+	if (base) UnmapViewOfFile(base);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (base) munmap((void*)base, size);
+	if (file >= 0) close(file);
+	file = -1;
+#endif
+	base = nullptr;
+	size = 0;
+}
+
+bool MappedScene::Open(const std::string& path, uint64_t source_hash) {
+	Close();
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	GetFileSizeEx(file, &file_size);
+	size = (size_t)file_size.QuadPart;
+	mapping = (size > 0) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	base = mapping ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+	file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat st;
+	fstat(file, &st);
+	size = (size_t)st.st_size;
+	if (size > 0) {
+		void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		base = (p == MAP_FAILED) ? nullptr : (const uint8_t*)p;
+	}
+#endif
+	if (!base) {
+		Close();
+		return false;
+	}
+
+	const size_t table_end = sizeof(SceneFile::Header) + SECTIONS * sizeof(SceneFile::SectionEntry);
+	const SceneFile::Header* header = (const SceneFile::Header*)base;
+	bool valid = size >= table_end
+		&& std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0
+		&& header->version == SceneFile::VERSION
+		&& header->sections == (uint32_t)SECTIONS
+		&& header->source_hash == source_hash
+		&& header->file_bytes == size;
+	const SceneFile::SectionEntry* table = (const SceneFile::SectionEntry*)(base + sizeof(SceneFile::Header));
+	for (int s = 0; valid && s < SECTIONS; s++) {
+		valid = table[s].offset >= table_end && table[s].offset <= size && table[s].bytes <= size - table[s].offset;
+	}
+	if (!valid) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+SceneFile::View MappedScene::Get(SceneFile::Section s) const {
+	if (!base || s >= SceneFile::Section::COUNT) {
+		return { nullptr, 0 };
+	}
+	const SceneFile::SectionEntry* table = (const SceneFile::SectionEntry*)(base + sizeof(SceneFile::Header));
+	return { base + table[(int)s].offset, (size_t)table[(int)s].bytes };
+}
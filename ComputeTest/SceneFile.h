@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "ShaderStructs.h"
+#include "Bvh.h"
+#include "TwoLevelBvh.h"
+
+/*
+ * Versioned binary scene cache. Every section is a verbatim copy of one SSBO of
+ * raycompute.comp, so a cached scene is mapped into memory and handed straight to
+ * glBufferData without parsing or building anything. Files are keyed on a hash of
+ * whatever the scene was built from; a mismatching version or hash is a cache miss.
+ *
+ * Layout: Header, one SectionEntry per Section, then the sections, each starting
+ * on an ALIGNMENT boundary.
+ */
+namespace SceneFile {
+	const uint32_t VERSION = 2;
+	const uint64_t ALIGNMENT = 256;
+
+	enum class Section : uint32_t {
+		SHAPES,		// objbuf, Shape with its Material
+		BVH,		// bvhbuf
+		TOP,		// topbuf
+		INSTANCES,	// instancebuf
+		MESH_BVH,	// meshbvhbuf
+		VERTICES,	// vertexbuf
+		INDICES,	// indexbuf
+		COUNT
+	};
+
+	// SSBO binding of each section in raycompute.comp.
+	const uint32_t BINDINGS[(int)Section::COUNT] = { 2, 4, 5, 6, 0, 3, 7 };
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t sections;
+		uint64_t source_hash;
+		uint64_t file_bytes;
+	};
+
+	struct SectionEntry {
+		uint64_t offset;
+		uint64_t bytes;
+	};
+
+	struct View {
+		const void* data;
+		size_t bytes;
+	};
+}
+
+// Host side contents of every scene buffer, as uploaded.
+struct SceneData {
+	std::vector<Shape> shapes;
+	std::vector<BvhNode> nodes;
+	std::vector<BvhNode> top;
+	std::vector<BvhInstance> instances;
+	std::vector<BvhNode> mesh_nodes;
+	std::vector<glm::vec4> vertices;
+	std::vector<uint32_t> indices;
+
+	SceneFile::View Get(SceneFile::Section s) const;
+};
+
+// 64 bit FNV-1a over everything a scene is built from.
+class SceneHash
+{
+private:
+	uint64_t value;
+
+public:
+	SceneHash();
+
+	void Add(const void* data, size_t bytes);
+
+	template <class T>
+	void Add(const T& v) {
+		Add(&v, sizeof(T));
+	}
+
+	template <class T>
+	void Add(const std::vector<T>& v) {
+		Add(v.data(), v.size() * sizeof(T));
+	}
+
+	// Hashes a file's contents, returns false if it cannot be read.
+	bool AddFile(const std::string& path);
+
+	uint64_t Value() const {
+		return value;
+	}
+};
+
+// Writes through a temporary file and renames it, so concurrent readers never map half a file.
+bool WriteSceneFile(const std::string& path, uint64_t source_hash, const SceneData& scene);
+
+// Read only mapping of a scene file, unmapped on destruction.
+class MappedScene
+{
+private:
+	const uint8_t* base;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+
+	void Close();
+
+public:
+	MappedScene();
+	~MappedScene();
+
+	MappedScene(const MappedScene&) = delete;
+	MappedScene& operator=(const MappedScene&) = delete;
+
+	// Maps `path`, fails quietly if it is missing, truncated, from another version or built from another source.
+	bool Open(const std::string& path, uint64_t source_hash);
+
+	SceneFile::View Get(SceneFile::Section s) const;
+};
@@ -2,7 +2,12 @@
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -11,6 +16,48 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "ProgramCache.h"
+#include "ShaderSource.h"
+
+// Locations of a program's default block uniforms, looked up once after linking.
+class UniformLocations
+{
+private:
+	std::unordered_map<std::string, GLint> locations;
+
+public:
+	void load(GLuint program)
+	{
+		locations.clear();
+		GLint count = 0, max_length = 0;
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+		std::string name(std::max(max_length, 1), '\0');
+		for (GLint i = 0; i < count; i++) {
+			GLsizei length = 0;
+			glGetActiveUniformName(program, (GLuint)i, (GLsizei)name.size(), &length, &name[0]);
+			std::string key = name.substr(0, length);
+			// Uniform block members have no location.
+			GLint location = glGetUniformLocation(program, key.c_str());
+			if (location < 0) {
+				continue;
+			}
+			locations[key] = location;
+			// Arrays are reported as "name[0]", also accept the bare name.
+			if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) {
+				locations[key.substr(0, key.size() - 3)] = location;
+			}
+		}
+	}
+
+	// -1 for names the program does not use, which glUniform* ignores.
+	GLint find(const std::string& name) const
+	{
+		auto it = locations.find(name);
+		return (it == locations.end()) ? -1 : it->second;
+	}
+};
+
 enum class ShaderType {
 	RENDER,
 	COMPUTE
@@ -19,63 +66,50 @@ enum class ShaderType {
 template <ShaderType SHADER_TYPE = ShaderType::RENDER>
 class Shader
 {
+private:
+	UniformLocations uniforms;
+	std::string vertexFile;
+	std::string fragmentFile;
+
 public:
 	unsigned int ID;
 	// constructor generates the shader on the fly
 	// ------------------------------------------------------------------------
-	Shader(const char* vertexPath, const char* fragmentPath)
+	Shader(const char* vertexPath, const char* fragmentPath) : vertexFile(vertexPath), fragmentFile(fragmentPath)
 	{
-		// 1. retrieve the vertex/fragment source code from filePath
+		// 1. retrieve the vertex/fragment source code from filePath, includes expanded
 		std::string vertexCode;
 		std::string fragmentCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		// ensure ifstream objects can throw exceptions:
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			// open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char * fShaderCode = fragmentCode.c_str();
-		// 2. compile shaders
-		unsigned int vertex, fragment;
-		// vertex shader
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
-		// fragment Shader
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
-		// shader Program
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
-		// delete the shaders as they're linked into our program now and no longer necessary
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
+		ShaderSource::Read(vertexPath, vertexCode);
+		ShaderSource::Read(fragmentPath, fragmentCode);
+		// 2. compile shaders, unless the program binary cache has them
+		ID = ProgramCache::Get(vertexCode + '\0' + fragmentCode, [&]() {
+			const char* vShaderCode = vertexCode.c_str();
+			const char * fShaderCode = fragmentCode.c_str();
+			unsigned int vertex, fragment;
+			// vertex shader
+			vertex = glCreateShader(GL_VERTEX_SHADER);
+			glShaderSource(vertex, 1, &vShaderCode, NULL);
+			glCompileShader(vertex);
+			checkCompileErrors(vertex, "VERTEX");
+			// fragment Shader
+			fragment = glCreateShader(GL_FRAGMENT_SHADER);
+			glShaderSource(fragment, 1, &fShaderCode, NULL);
+			glCompileShader(fragment);
+			checkCompileErrors(fragment, "FRAGMENT");
+			// shader Program
+			GLuint program = glCreateProgram();
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glAttachShader(program, vertex);
+			glAttachShader(program, fragment);
+			glLinkProgram(program);
+			checkCompileErrors(program, "PROGRAM");
+			// delete the shaders as they're linked into our program now and no longer necessary
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			return program;
+		});
+		uniforms.load(ID);
 	}
 
 
@@ -85,21 +119,39 @@ public:
 	{
 		glUseProgram(ID);
 	}
+	// stages and files the program is built from, see ShaderReloader
+	// ------------------------------------------------------------------------
+	std::vector<std::pair<GLenum, std::string>> stages() const
+	{
+		return { { GL_VERTEX_SHADER, vertexFile }, { GL_FRAGMENT_SHADER, fragmentFile } };
+	}
+	std::string defines() const
+	{
+		return "";
+	}
+	// swap in a program rebuilt from the same stages, default block uniforms start over
+	// ------------------------------------------------------------------------
+	void reload(GLuint program)
+	{
+		glDeleteProgram(ID);
+		ID = program;
+		uniforms.load(ID);
+	}
 	// utility uniform functions
 	// ------------------------------------------------------------------------
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(uniforms.find(name), (int)value);
 	}
 	// ------------------------------------------------------------------------
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(uniforms.find(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(uniforms.find(name), value);
 	}
 
 
@@ -108,13 +160,13 @@ public:
 	{
 		switch (N) {
 		case 2: {
-			glUniform2fv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniform2fv(uniforms.find(name), vec);
 		}; break;
 		case 3: {
-			glUniform3fv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniform3fv(uniforms.find(name), vec);
 		}; break;
 		case 4: {
-			glUniform4fv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniform4fv(uniforms.find(name), vec);
 		}; break;
 		}
 	}
@@ -124,13 +176,13 @@ public:
 	{
 		switch (N) {
 		case 2: {
-			glUniform2iv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniform2iv(uniforms.find(name), vec);
 		}; break;
 		case 3: {
-			glUniform3iv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniform3iv(uniforms.find(name), vec);
 		}; break;
 		case 4: {
-			glUniform4iv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniform4iv(uniforms.find(name), vec);
 		}; break;
 		}
 	}
@@ -140,13 +192,13 @@ public:
 	{
 		switch (N) {
 		case 2: {
-			glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniformMatrix2fv(uniforms.find(name), vec);
 		}; break;
 		case 3: {
-			glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniformMatrix3fv(uniforms.find(name), vec);
 		}; break;
 		case 4: {
-			glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), vec);
+			glUniformMatrix4fv(uniforms.find(name), vec);
 		}; break;
 		}
 	}
@@ -183,45 +235,36 @@ template <>
 class Shader<ShaderType::COMPUTE> {
 private:
 	unsigned int ID;
+	UniformLocations uniforms;
+	std::string computeFile;
+	std::string preamble;
 
 public:
-	Shader(const char* computePath) {
+	// `defines` is pasted right after the #version line, e.g. "#define TILE_W 8\n".
+	Shader(const char* computePath, const std::string& defines = "") : computeFile(computePath), preamble(defines) {
+		// 1. retrieve the source code, includes expanded and defines injected
 		std::string computeCode;
-		std::ifstream cShaderFile;
-		// ensure ifstream objects can throw exceptions:
-		cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			// open files
-			cShaderFile.open(computePath);
-			std::stringstream cShaderStream;
-			// read file's buffer contents into streams
-			cShaderStream << cShaderFile.rdbuf();
-
-			// close file handlers
-			cShaderFile.close();
-			// convert stream into string
-			computeCode = cShaderStream.str();
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-		}
-		const char* cShaderCode = computeCode.c_str();
-		// 2. compile shaders
-		unsigned int compute;
-		// vertex shader
-		compute = glCreateShader(GL_COMPUTE_SHADER);
-		glShaderSource(compute, 1, &cShaderCode, NULL);
-		glCompileShader(compute);
-		checkCompileErrors(compute, "COMPUTE");
-		// shader Program
-		ID = glCreateProgram();
-		glAttachShader(ID, compute);
-		glLinkProgram(ID);
-		checkCompileErrors(ID, "PROGRAM");
-		// delete the shaders as they're linked into our program now and no longer necessary
-		glDeleteShader(compute);
+		ShaderSource::Read(computePath, computeCode);
+		ShaderSource::Inject(computeCode, defines);
+		// 2. compile shaders, unless the program binary cache has them
+		ID = ProgramCache::Get(computeCode, [&]() {
+			const char* cShaderCode = computeCode.c_str();
+			unsigned int compute;
+			compute = glCreateShader(GL_COMPUTE_SHADER);
+			glShaderSource(compute, 1, &cShaderCode, NULL);
+			glCompileShader(compute);
+			checkCompileErrors(compute, "COMPUTE");
+			// shader Program
+			GLuint program = glCreateProgram();
+			glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glAttachShader(program, compute);
+			glLinkProgram(program);
+			checkCompileErrors(program, "PROGRAM");
+			// delete the shaders as they're linked into our program now and no longer necessary
+			glDeleteShader(compute);
+			return program;
+		});
+		uniforms.load(ID);
 	}
 
 	void use()
@@ -229,38 +272,58 @@ public:
 		glUseProgram(ID);
 	}
 
+	// stages and files the program is built from, see ShaderReloader
+	// ------------------------------------------------------------------------
+	std::vector<std::pair<GLenum, std::string>> stages() const
+	{
+		return { { GL_COMPUTE_SHADER, computeFile } };
+	}
+	const std::string& defines() const
+	{
+		return preamble;
+	}
+	// swap in a program rebuilt from the same stages, default block uniforms start over
+	// ------------------------------------------------------------------------
+	void reload(GLuint program)
+	{
+		glDeleteProgram(ID);
+		ID = program;
+		uniforms.load(ID);
+	}
+
 	// utility uniform functions
 	// ------------------------------------------------------------------------
 	void setBool(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		glUniform1i(uniforms.find(name), (int)value);
 	}
 	// ------------------------------------------------------------------------
 	void setInt(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1i(uniforms.find(name), value);
 	}
 	// ------------------------------------------------------------------------
 	void setFloat(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		glUniform1f(uniforms.find(name), value);
 	}
 
 	template <int N>
 	void setVector(const std::string &name, const glm::vec<N, float, glm::packed_highp>& vec)
 	{
-		if (glGetUniformLocation(ID, name.c_str()) < 0) {
+		GLint location = uniforms.find(name);
+		if (location < 0) {
 			std::cout << "ERR::" << name << "_DOES_NOT_EXIST" << std::endl;
 		}
 		switch (N) {
 		case 2: {
-			glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(vec));
+			glUniform2fv(location, 1, glm::value_ptr(vec));
 		}; break;
 		case 3: {
-			glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(vec));
+			glUniform3fv(location, 1, glm::value_ptr(vec));
 		}; break;
 		case 4: {
-			glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(vec));
+			glUniform4fv(location, 1, glm::value_ptr(vec));
 		}; break;
 		}
 	}
@@ -270,13 +333,13 @@ public:
 	{
 		switch (N) {
 		case 2: {
-			glUniform2iv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(vec));
+			glUniform2iv(uniforms.find(name), 1, glm::value_ptr(vec));
 		}; break;
 		case 3: {
-			glUniform3iv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(vec));
+			glUniform3iv(uniforms.find(name), 1, glm::value_ptr(vec));
 		}; break;
 		case 4: {
-			glUniform4iv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(vec));
+			glUniform4iv(uniforms.find(name), 1, glm::value_ptr(vec));
 		}; break;
 		}
 	}
@@ -286,13 +349,13 @@ public:
 	{
 		switch (N) {
 		case 2: {
-			glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(vec));
+			glUniformMatrix2fv(uniforms.find(name), 1, GL_FALSE, glm::value_ptr(vec));
 		}; break;
 		case 3: {
-			glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(vec));
+			glUniformMatrix3fv(uniforms.find(name), 1, GL_FALSE, glm::value_ptr(vec));
 		}; break;
 		case 4: {
-			glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(vec));
+			glUniformMatrix4fv(uniforms.find(name), 1, GL_FALSE, glm::value_ptr(vec));
 		}; break;
 		}
 	}
@@ -324,3 +387,30 @@ private:
 		}
 	}
 };
+
+// Compiled variants of one compute shader, keyed on their defines, so switching
+// back to a feature set seen before costs a lookup instead of a compile.
+class ComputeVariants
+{
+private:
+	std::string path;
+	std::unordered_map<std::string, std::unique_ptr<Shader<ShaderType::COMPUTE>>> programs;
+
+public:
+	explicit ComputeVariants(const std::string& path) : path(path) {
+	}
+
+	Shader<ShaderType::COMPUTE>& get(const std::string& defines)
+	{
+		std::unique_ptr<Shader<ShaderType::COMPUTE>>& program = programs[defines];
+		if (!program) {
+			program.reset(new Shader<ShaderType::COMPUTE>(path.c_str(), defines));
+		}
+		return *program;
+	}
+
+	size_t size() const
+	{
+		return programs.size();
+	}
+};
@@ -0,0 +1,246 @@
+#include "ShaderReloader.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "ShaderSource.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace {
+
+	// Saving a file takes editors more than one write, so changes are looked for at most this often.
+	const std::chrono::milliseconds INTERVAL(250);
+
+	bool HasExtension(const char* name) {
+		GLint n = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+		for (GLint i = 0; i < n; i++) {
+			const char* e = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (e && std::strcmp(e, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::filesystem::file_time_type WriteTime(const std::string& path) {
+		std::error_code error;
+		return std::filesystem::last_write_time(path, error);
+	}
+
+	// Every stage's source with includes expanded and defines injected, and the files they came from.
+	bool Read(const std::vector<std::pair<GLenum, std::string>>& stages, const std::string& defines,
+		std::vector<std::string>& sources, std::vector<std::pair<std::string, std::filesystem::file_time_type>>& files) {
+		sources.clear();
+		files.clear();
+		bool ok = true;
+		for (const auto& stage : stages) {
+			std::vector<std::string> paths;
+			std::string source;
+			ok = ShaderSource::Read(stage.second, source, &paths) && ok;
+			ShaderSource::Inject(source, defines);
+			sources.push_back(source);
+			if (paths.empty()) {
+				paths.push_back(stage.second);
+			}
+			for (const std::string& path : paths) {
+				files.emplace_back(path, WriteTime(path));
+			}
+		}
+		return ok;
+	}
+
+	// Issues the compile and link without waiting for either.
+	GLuint Start(const std::vector<std::pair<GLenum, std::string>>& stages, const std::vector<std::string>& sources, std::vector<GLuint>& shaders) {
+		GLuint program = glCreateProgram();
+		shaders.clear();
+		for (size_t i = 0; i < stages.size(); i++) {
+			const char* code = sources[i].c_str();
+			GLuint shader = glCreateShader(stages[i].first);
+			glShaderSource(shader, 1, &code, NULL);
+			glCompileShader(shader);
+			glAttachShader(program, shader);
+			shaders.push_back(shader);
+		}
+		glLinkProgram(program);
+		return program;
+	}
+
+	// Waits for the build if it is still running. On failure prints why and deletes the program.
+	bool Finish(const std::vector<std::pair<GLenum, std::string>>& stages, GLuint program, const std::vector<GLuint>& shaders) {
+		char info[1024];
+		bool ok = true;
+		for (size_t i = 0; i < shaders.size(); i++) {
+			GLint compiled = GL_FALSE;
+			glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+			if (!compiled) {
+				glGetShaderInfoLog(shaders[i], sizeof(info), NULL, info);
+				std::cout << "ERR::SHADER_RELOAD::COMPILE_FAIL " << stages[i].second << "\n" << info << std::endl;
+				ok = false;
+			}
+			glDetachShader(program, shaders[i]);
+			glDeleteShader(shaders[i]);
+		}
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (ok && !linked) {
+			glGetProgramInfoLog(program, sizeof(info), NULL, info);
+			std::cout << "ERR::SHADER_RELOAD::LINK_FAIL " << stages[0].second << "\n" << info << std::endl;
+		}
+		if (!ok || !linked) {
+			glDeleteProgram(program);
+			return false;
+		}
+		return true;
+	}
+}
+
+ShaderReloader::ShaderReloader(BindContext bind_worker) :
+	mode(Mode::BLOCKING),
+	bind_worker(bind_worker),
+	last_check(Clock::now()),
+	stop(false) {
+
+	// The worker comes first: Mesa still parses and links in glCompileShader/glLinkProgram
+	// with the extension, which stalled llvmpipe for half a second where the worker did not.
+	if (bind_worker) {
+		mode = Mode::WORKER;
+		worker = std::thread(&ShaderReloader::Work, this);
+	} else if (HasExtension("GL_KHR_parallel_shader_compile") || HasExtension("GL_ARB_parallel_shader_compile")) {
+		mode = Mode::PARALLEL;
+	}
+}
+
+ShaderReloader::~ShaderReloader() {
+	if (worker.joinable()) {
+		stop = true;
+		wake.notify_all();
+		worker.join();
+	}
+	for (auto& r : ready) {
+		glDeleteProgram(r.second);
+	}
+	for (auto& e : entries) {
+		if (e->pending) {
+			for (GLuint shader : e->pending_shaders) glDeleteShader(shader);
+			glDeleteProgram(e->pending);
+		}
+	}
+}
+
+void ShaderReloader::Add(const std::vector<std::pair<GLenum, std::string>>& stages, const std::string& defines, std::function<void(GLuint)> swap) {
+	std::unique_ptr<Entry> entry(new Entry());
+	entry->stages = stages;
+	entry->defines = defines;
+	entry->swap = swap;
+	std::vector<std::string> sources;
+	Read(stages, defines, sources, entry->files);
+
+	std::lock_guard<std::mutex> guard(lock);
+	entries.push_back(std::move(entry));
+}
+
+int ShaderReloader::Poll() {
+	int swapped = 0;
+
+	if (mode == Mode::WORKER) {
+		std::vector<std::pair<Entry*, GLuint>> linked;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			linked.swap(ready);
+		}
+		for (auto& l : linked) {
+			l.first->swap(l.second);
+			std::cout << "Reloaded " << l.first->stages.back().second << std::endl;
+			swapped++;
+		}
+		return swapped;
+	}
+
+	// Builds the driver finished since the last frame.
+	for (auto& e : entries) {
+		GLint done = GL_FALSE;
+		if (e->pending) {
+			glGetProgramiv(e->pending, GL_COMPLETION_STATUS_KHR, &done);
+		}
+		if (done) {
+			if (Finish(e->stages, e->pending, e->pending_shaders)) {
+				e->swap(e->pending);
+				std::cout << "Reloaded " << e->stages.back().second << std::endl;
+				swapped++;
+			}
+			e->pending = 0;
+			e->pending_shaders.clear();
+		}
+	}
+
+	if (Clock::now() - last_check < INTERVAL) {
+		return swapped;
+	}
+	last_check = Clock::now();
+
+	for (auto& e : entries) {
+		if (e->pending) continue;
+		bool changed = false;
+		for (const auto& f : e->files) {
+			changed = changed || WriteTime(f.first) != f.second;
+		}
+		if (!changed) continue;
+
+		// A file missing mid save is retried once it is back, its time will have changed again.
+		std::vector<std::string> sources;
+		if (!Read(e->stages, e->defines, sources, e->files)) continue;
+		GLuint program = Start(e->stages, sources, e->pending_shaders);
+		if (mode == Mode::PARALLEL) {
+			e->pending = program;
+		} else if (Finish(e->stages, program, e->pending_shaders)) {
+			e->swap(program);
+			std::cout << "Reloaded " << e->stages.back().second << std::endl;
+			swapped++;
+		}
+	}
+	return swapped;
+}
+
+void ShaderReloader::Work() {
+	if (!bind_worker(true)) {
+		std::cout << "ERR::SHADER_RELOAD::WORKER_CONTEXT_FAIL" << std::endl;
+		return;
+	}
+
+	while (!stop) {
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait_for(guard, INTERVAL, [this]() { return stop.load(); });
+		}
+		if (stop) break;
+
+		std::vector<Entry*> watched;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			for (auto& e : entries) watched.push_back(e.get());
+		}
+		for (Entry* e : watched) {
+			bool changed = false;
+			for (const auto& f : e->files) {
+				changed = changed || WriteTime(f.first) != f.second;
+			}
+			if (!changed) continue;
+
+			std::vector<std::string> sources;
+			std::vector<GLuint> shaders;
+			if (!Read(e->stages, e->defines, sources, e->files)) continue;
+			GLuint program = Start(e->stages, sources, shaders);
+			if (Finish(e->stages, program, shaders)) {
+				// Complete before the render context can see it.
+				glFinish();
+				std::lock_guard<std::mutex> guard(lock);
+				ready.emplace_back(e, program);
+			}
+		}
+	}
+	bind_worker(false);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+
+/*
+ * Hot reload for Shader programs. Watched shaders are rebuilt from their files,
+ * includes and defines as before, whenever one of the files changes, and swapped
+ * in by Poll() between frames once the new program has linked. A program that
+ * fails to compile or link is reported and the previous one stays in use.
+ *
+ * Compilation stays off the render thread. Given `bind_worker`, a worker thread
+ * compiles on a context shared with the render one, made current through it.
+ * Otherwise, with KHR_parallel_shader_compile, the driver compiles in the
+ * background and Poll() only asks whether it is done. Without either, Poll()
+ * compiles in place.
+ */
+class ShaderReloader
+{
+public:
+	// Makes the shared context current on the calling thread (true) or releases it (false).
+	using BindContext = std::function<bool(bool current)>;
+
+	enum class Mode {
+		WORKER,		// worker thread on a shared context
+		PARALLEL,	// KHR_parallel_shader_compile on the render context
+		BLOCKING	// in Poll(), stalls the frame it happens in
+	};
+
+	explicit ShaderReloader(BindContext bind_worker = nullptr);
+	~ShaderReloader();
+
+	ShaderReloader(const ShaderReloader&) = delete;
+	ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+	// `shader` must outlive this.
+	template <ShaderType T>
+	void Watch(Shader<T>& shader) {
+		Add(shader.stages(), shader.defines(), [&shader](GLuint program) { shader.reload(program); });
+	}
+
+	// Render thread, once per frame. Swaps in every program rebuilt since, returns how many.
+	int Poll();
+
+	Mode GetMode() const {
+		return mode;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+	using FileTime = std::filesystem::file_time_type;
+
+	struct Entry {
+		std::vector<std::pair<GLenum, std::string>> stages;
+		std::string defines;
+		std::function<void(GLuint)> swap;
+		std::vector<std::pair<std::string, FileTime>> files;	// stages with their includes, as last built
+
+		// PARALLEL only, a build the driver is still working on.
+		GLuint pending = 0;
+		std::vector<GLuint> pending_shaders;
+	};
+
+	Mode mode;
+	BindContext bind_worker;
+	std::vector<std::unique_ptr<Entry>> entries;
+	Clock::time_point last_check;
+
+	// WORKER hands linked programs over through `ready`, under `lock`.
+	std::mutex lock;
+	std::condition_variable wake;
+	std::vector<std::pair<Entry*, GLuint>> ready;
+	std::atomic<bool> stop;
+	std::thread worker;
+
+	void Add(const std::vector<std::pair<GLenum, std::string>>& stages, const std::string& defines, std::function<void(GLuint)> swap);
+	void Work();
+};
@@ -0,0 +1,85 @@
+#include "ShaderSource.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace {
+
+	std::string Directory(const std::string& path) {
+		size_t slash = path.find_last_of("/\\");
+		return (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+	}
+
+	// The file name of an #include "file" line, empty for any other line.
+	std::string IncludeName(const std::string& line) {
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line.compare(i, 8, "#include") != 0) {
+			return "";
+		}
+		size_t open = line.find('"', i + 8);
+		size_t close = (open == std::string::npos) ? open : line.find('"', open + 1);
+		return (close == std::string::npos) ? "" : line.substr(open + 1, close - open - 1);
+	}
+
+	bool Expand(const std::string& path, int string_number, std::set<std::string>& included, int& next_string, std::ostream& out) {
+		std::ifstream file(path);
+		if (!file) {
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+			return false;
+		}
+		included.insert(path);
+
+		std::string line;
+		int number = 0;
+		while (std::getline(file, line)) {
+			number++;
+			std::string name = IncludeName(line);
+			if (name.empty()) {
+				out << line << '\n';
+				continue;
+			}
+			std::string include = Directory(path) + name;
+			if (included.count(include) == 0) {
+				const int child = next_string++;
+				out << "#line 1 " << child << '\n';
+				if (!Expand(include, child, included, next_string, out)) {
+					return false;
+				}
+			}
+			out << "#line " << number + 1 << ' ' << string_number << '\n';
+		}
+		return true;
+	}
+}
+
+bool ShaderSource::Read(const std::string& path, std::string& source, std::vector<std::string>* files) {
+	std::set<std::string> included;
+	std::stringstream out;
+	int next_string = 1;
+	if (!Expand(path, 0, included, next_string, out)) {
+		return false;
+	}
+	source = out.str();
+	if (files) {
+		files->insert(files->end(), included.begin(), included.end());
+	}
+	return true;
+}
+
+void ShaderSource::Inject(std::string& source, const std::string& defines) {
+	if (defines.empty()) {
+		return;
+	}
+	size_t version = source.find("#version");
+	size_t version_end = (version == std::string::npos) ? std::string::npos : source.find('\n', version);
+	if (version_end == std::string::npos) {
+		source.insert(0, defines);
+		return;
+	}
+	// Lines after the defines keep their numbers in compiler messages.
+	const size_t version_line = std::count(source.begin(), source.begin() + version, '\n') + 1;
+	source.insert(version_end + 1, defines + "#line " + std::to_string(version_line + 1) + " 0\n");
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/*
+ * GLSL text as handed to glShaderSource. Lines of the form #include "file" are
+ * replaced by that file, looked up next to the file including it, and every file
+ * is pasted once at most. #line directives keep compiler messages pointing at the
+ * right line, with the source string number counting included files from 1.
+ */
+namespace ShaderSource {
+	// False, after printing why, if `path` or anything it includes cannot be read.
+	// `files`, if given, receives `path` and everything it included.
+	bool Read(const std::string& path, std::string& source, std::vector<std::string>* files = nullptr);
+
+	// Pastes `defines` right after the #version line, e.g. "#define TILE_W 8\n".
+	void Inject(std::string& source, const std::string& defines);
+}
@@ -15,6 +15,7 @@ enum class ShapeType : uint32_t {
 	SPHERE		= 0x00000001u,
 	CUBOID		= 0x00000002u,
 	RECT		= 0x00000003u,
+	MESH		= 0x00000004u,
 	ISOTROPIC	= 0xF0000000u,
 	ISO_SPHERE	= SPHERE | ISOTROPIC,
 	ISO_CUBOID	= CUBOID | ISOTROPIC
@@ -25,7 +26,9 @@ struct Shape {
 	uint32_t shape_type;
 	float B[3];
 	float rotation;
-	float params[4];
+	float density;
+	uint32_t light;		// 1 + index in the Lights table when sampled directly, else 0
+	float __padd[2];
 	float C[3];
 	float param;
 	float D[3];
@@ -36,9 +39,9 @@ struct Sphere {
 	float position[3];
 	uint32_t shape_type;
 	float radius[3];
-	uint32_t __padd1[1];
-	float dense;
-	float __padd2[3];
+	uint32_t __padd1[1] = {};
+	float dense = 0.0f;
+	float __padd2[3] = {};
 	float color[3];
 	float param;
 	float emit[3];
@@ -75,8 +78,8 @@ struct Cuboid {
 	uint32_t shape_type;
 	float diagonal[3];
 	uint32_t rotation;
-	float dense;
-	float __padd2[3];
+	float dense = 0.0f;
+	float __padd2[3] = {};
 	float color[3];
 	float param;
 	float emit[3];
@@ -118,7 +121,7 @@ struct Rect {
 	uint32_t shape_type;
 	float diagonal[3];
 	uint32_t axis;
-	float __padd2[4];
+	float __padd2[4] = {};
 	float color[3];
 	float param;
 	float emit[3];
@@ -162,6 +165,45 @@ struct Rect {
 	}
 };
 
+/*
+ * Triangle mesh stored in a MeshPool. Only its bounds and the root of its own
+ * BVH live here, the triangles are in the pool's vertex and index buffers.
+ */
+struct MeshShape {
+	float bmin[3];
+	uint32_t shape_type;
+	float bmax[3];
+	uint32_t root;
+	float __padd2[4] = {};
+	float color[3];
+	float param;
+	float emit[3];
+	uint32_t mat_type;
+
+	MeshShape(const glm::vec3& lo, const glm::vec3& hi, uint32_t root, const glm::vec3& col, const glm::vec3& emissive, float param, MaterialType type) :
+		shape_type(static_cast<uint32_t>(ShapeType::MESH)),
+		root(root),
+		param(param),
+		mat_type(static_cast<uint32_t>(type)) {
+		bmin[0] = lo.x;
+		bmin[1] = lo.y;
+		bmin[2] = lo.z;
+		bmax[0] = hi.x;
+		bmax[1] = hi.y;
+		bmax[2] = hi.z;
+		color[0] = col.r;
+		color[1] = col.g;
+		color[2] = col.b;
+		emit[0] = emissive.r;
+		emit[1] = emissive.g;
+		emit[2] = emissive.b;
+	}
+
+	operator Shape() {
+		return *(Shape*)this;
+	}
+};
+
 template <class T> 
 struct Volume : public T {
 public:
@@ -6,13 +6,25 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "ShaderStructs.h"
-#include <random>
+#include "Scene.h"
+#include "Bvh.h"
+#include "Tile.h"
+#include "FrameUniforms.h"
+#include "RayVariant.h"
+#include "ShaderReloader.h"
+#include "GpuProfiler.h"
+#include "RayStats.h"
+#include "TraceRecorder.h"
+#include "Lights.h"
+#include <memory>
 #include <iomanip>
 #include <stbi/stb_image.h>
 
+#ifdef _WIN32
 extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
 }
+#endif
 
 const float rad2deg = 180.0f/ 3.1415926535f;
 
@@ -26,6 +38,9 @@ int main() {
 	const int CHUNKS_Y	  = 2;
 	const bool FULLSCREEN = true;
 	const bool SKYBOX_ACTIVE = false;
+	const bool RAY_STATS  = false;	// instrumented shader, prints its counters every frame
+	const char* TRACE_FILE = nullptr;	// e.g. "trace.json", Chrome trace of the session
+	const Tile& TILE      = TILES[0];
 
 	if (!glfwInit()) {
 		std::cerr << "ERR::GLFW::INIT_FAIL" << std::endl;
@@ -86,9 +101,32 @@ int main() {
 	glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &work_grp_inv);
 	std::cout << "Max invocations: " << work_grp_inv << std::endl;
 
-	// Creating the shaders
-	Shader<ShaderType::COMPUTE> compshdr("raycompute.comp");
+	// The scene, the compute shader is compiled for just the materials and shapes in it.
+	std::vector<Shape> obj = CornellScene();
+	Lights::Tag(obj);
+	const RayVariant variant = RayVariant::ForScene(obj, false, SKYBOX_ACTIVE);
+
+	// Creating the shaders, from program binaries cached by the last run where the driver allows it
+	ProgramCache::SetDirectory("shader_cache");
+	Shader<ShaderType::COMPUTE> compshdr("raycompute.comp", TILE.Defines() + variant.Defines() + (RAY_STATS ? RayStats::Defines() : ""));
 	Shader<ShaderType::RENDER> drawshdr("vDraw.vert", "fDraw.frag");
+	const ProgramCache::Stats& programs = ProgramCache::Statistics();
+	std::cout << "Programs: " << programs.hits << '/' << programs.programs << " from the cache, " << programs.load_ms + programs.compile_ms << " ms" << std::endl;
+
+	// Saved edits to the shaders show up without a restart. Without parallel compile in the
+	// driver they are rebuilt on a hidden window's context, shared with the main one.
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* reload_context = glfwCreateWindow(1, 1, "TracerGL reload", nullptr, window);
+	ShaderReloader::BindContext bind_reload_context;
+	if (reload_context) {
+		bind_reload_context = [reload_context](bool current) {
+			glfwMakeContextCurrent(current ? reload_context : nullptr);
+			return true;
+		};
+	}
+	std::unique_ptr<ShaderReloader> reloader(new ShaderReloader(bind_reload_context));
+	reloader->Watch(compshdr);
+	reloader->Watch(drawshdr);
 
 	// Generating the render quad. Just a simple quad.
 	float quad[] = {
@@ -156,62 +194,9 @@ int main() {
 		glBindImageTexture(3, tex_sky, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA8);
 	}
 
-	// SSBO for rng
-	std::default_random_engine rng;
-	std::uniform_int_distribution<uint32_t> distr;
-	std::vector<GLuint> init_rng(WIDTH * HEIGHT);
-	/*for (GLuint& i : init_rng) {
-		i = distr(rng);
-	}*/
-	for (int i = 0; i < WIDTH; i++) {
-		for (int j = 0; j < HEIGHT; j++) {
-			init_rng[j*WIDTH + i] = distr(rng);
-		}
-	}
-
-
-	compshdr.use();
-	GLuint SSBO_rng;
-	glGenBuffers(1, &SSBO_rng);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, SSBO_rng);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, init_rng.size() * sizeof(GLuint), init_rng.data(), GL_DYNAMIC_DRAW);
-
 	// SSBO for the spheres.
-	//std::vector<Shape> obj{
-	//	(Sphere({-0.176776f, 0, -0.176776f}, 0.25f, {0.1f, 0.2f, 0.5f}, {4.0f, 4.0f, 4.0f}, 1.0f, MaterialType::LAMBERTIAN)),
-	//	(Cuboid({0, 0, 0}, {0.5f, 0.5f, 0.5f}, {0.9f, 0.9f, 0.9f}, 0.1f, MaterialType::LAMBERTIAN)),
-	//	(Rect({-0.5f, -0.5f, -0.5f}, {1.0f, 1.0f, 0.0f}, {0.1f, 0.8f, 0.1f}, 0.0f, MaterialType::LAMBERTIAN))
-	//	/*,
-	//	{ {0,-100.5,0}	, 100.0f, {0.9f, 0.9f, 0.9f}, 0.0f, MaterialType::LAMBERTIAN},
-	//	{ {1,0,0}		,	0.5f, {0.8f, 0.6f, 0.2f}, 0.5f, MaterialType::METALLIC	},
-	//	{ {-1,0,0}		,	0.5f, {1.0f, 1.0f, 1.0f}, 1.5f, MaterialType::DIELECTRIC},
-	//	{ {-1,0,0}		, -0.48f, {1.0f, 1.0f, 1.0f}, 1.5f, MaterialType::DIELECTRIC} */
-	//};
-
-	std::vector<Shape> obj{
-		(Rect(glm::vec3{-3,-3,-2}, glm::vec3(6,6,0), glm::vec3(0.73f), 1.0f, MaterialType::LAMBERTIAN)),
-		(Rect(glm::vec3(-3,-3,-2), glm::vec3(0,6,6), glm::vec3(0.65f, 0.05f, 0.05f), 1.0f, MaterialType::LAMBERTIAN)),
-		(Rect(glm::vec3(3,-3,-2), glm::vec3(0,6,6), glm::vec3(0.12f, 0.45f, 0.15f), 1.0f, MaterialType::LAMBERTIAN, -1.0f)),
-		(Rect(glm::vec3(-3,-3,-2), glm::vec3(6,0,6), glm::vec3(0.8f, 0.8f, 0.8f), 1.0f, MaterialType::LAMBERTIAN, 1.0f)),
-		(Rect(glm::vec3(-3, 3,-2), glm::vec3(6,0,6), glm::vec3(0.8f, 0.8f, 0.8f), 1.0f, MaterialType::LAMBERTIAN, -1.0f)),
-		(Rect(glm::vec3(-2.0f, 2.99f,-1.0f), glm::vec3(4,0,4), glm::vec3(0.8f, 0.8f, 0.8f), glm::vec3(2.0f), 1.0f, MaterialType::LAMBERTIAN, -1.0f)),
-		(Cuboid(glm::vec3(-2.5, -3, -1), glm::vec3(2,4,2), 20.0f, glm::vec3(0.8f), 0.1f, MaterialType::LAMBERTIAN)),
-		(Volume<Cuboid>(0.4f, glm::vec3(0.0f, -2.99, 1), glm::vec3(2,2,2), -30.0f, glm::vec3(1.0f), 0.0f, MaterialType::ISOTROPIC)),
-		(Sphere(glm::vec3(-2.5f, 1.5f, -1.0f), 0.5f, glm::vec3(1.0f), 1.5f, MaterialType::DIELECTRIC)),
-		(Volume<Sphere>(0.7f, glm::vec3(-2.5f, 1.5f, -1.0f), 0.49f, glm::vec3(0.1f, 0.1f, 0.9f), 0.1f, MaterialType::ISOTROPIC))
-	};
-
-	/*const float rif = 0.5f / (float)INT_MAX;
-	int index = 1302;
-	for (int i = -5; i < 6; i++) {
-		for (int j = -5; j < 6; j++) {
-			if (i*i < 4 && j*j < 1) continue;
-			if (init_rng[index++]*rif > 0.1)
-				obj.emplace_back(glm::vec3{ i + init_rng[index++]*rif*0.5f - 0.25f, -0.25f, j + init_rng[index++] *rif*0.5f - 0.25f }, 0.25f, glm::vec3{ 0.8f *init_rng[index++] * rif,0.8f*init_rng[index++] *rif,0.8f*init_rng[index++]*rif }, init_rng[index++]*rif*0.7f + 0.3f, (init_rng[index++] % 2) ? MaterialType::LAMBERTIAN : MaterialType::METALLIC);
-			else
-				obj.emplace_back(glm::vec3{ i + init_rng[index++]*rif*0.5f - 0.25f, -0.25f, j + init_rng[index++] *rif*0.5f - 0.25f }, 0.25f, glm::vec3{ 1.0f }, 1.4f, MaterialType::DIELECTRIC);
-		}
-	} */
+	std::vector<BvhNode> bvh = Bvh::Build(obj);
+	std::cout << "BVH: " << bvh.size() << " nodes over " << obj.size() << " objects, SAH cost " << Bvh::Cost(bvh) << std::endl;
 
 	compshdr.use();
 	GLuint SSBO_objects;
@@ -219,10 +204,20 @@ int main() {
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, SSBO_objects);
 	glBufferData(GL_SHADER_STORAGE_BUFFER, obj.size() * sizeof(Sphere), obj.data(), GL_STATIC_DRAW);
 
+	// The lamp, sampled at every diffuse bounce.
+	std::unique_ptr<Lights> lights(new Lights(obj));
+
+	// SSBO for the BVH over the objects.
+	GLuint SSBO_bvh;
+	glGenBuffers(1, &SSBO_bvh);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, SSBO_bvh);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, bvh.size() * sizeof(BvhNode), bvh.data(), GL_STATIC_DRAW);
+
 	// Camera for the system.
 	//Camera cam({ -4,3,4 }, { 0,0,0}, { 0,1,0 }, 30.0f, (float)WIDTH / (float)HEIGHT, 0.1f);
 	Camera cam({ 0,0,16 }, { 0,0,0 }, { 0,1,0 }, 30.0f, (float)WIDTH / (float)HEIGHT);
-	cam.Bind(compshdr);
+	FrameUniforms frame;
+	cam.Bind(frame.Block());
 
 	// Variables.
 	int iteration = 0;
@@ -231,7 +226,7 @@ int main() {
 	const int CHUNK_W = TEX_W / CHUNKS_X;
 	const int CHUNK_H = TEX_H / CHUNKS_Y;
 	const int N_CHUNKS = CHUNKS_X * CHUNKS_Y;
-	compshdr.setBool("skybox_active", SKYBOX_ACTIVE);
+	frame.Block().skybox_active = SKYBOX_ACTIVE;
 	
 	// Chunks must divide the screen properly.
 	if (TEX_H%CHUNKS_Y != 0 || TEX_W % CHUNKS_X != 0) {
@@ -239,23 +234,50 @@ int main() {
 		glfwSetWindowShouldClose(window, GLFW_TRUE);
 	}
 
+	// GPU time of every pass, printed on exit. The FPS line below is CPU side.
+	GpuProfiler profiler;
+	std::unique_ptr<TraceRecorder> trace(TRACE_FILE ? new TraceRecorder(TRACE_FILE) : nullptr);
+	profiler.SetTrace(trace.get());
+	std::unique_ptr<RayStats> stats(RAY_STATS ? new RayStats() : nullptr);
+
 	double prev = start;\
 		try {
 		while (!glfwWindowShouldClose(window)) {
+			TraceScope frame_scope(trace.get(), "frame");
+
+			// A rebuilt shader starts the accumulation over, with other random numbers.
+			{
+				TraceScope scope(trace.get(), "reload");
+				if (reloader->Poll() > 0) {
+					iteration = 0;
+					frame.Block().seed++;
+					start = prev = glfwGetTime();
+				}
+			}
 
 			// Compute shader dispatch.
 			{
 				int chunk_x, chunk_y;
 				chunk_x = iteration % CHUNKS_X;
 				chunk_y = (iteration / CHUNKS_X) % CHUNKS_Y;
+				frame.Block().iteration = iteration++ / N_CHUNKS;
+				frame.Block().time = (float)glfwGetTime();
+				frame.Block().SetChunk(glm::ivec2(chunk_x * CHUNK_W, chunk_y * CHUNK_H), glm::ivec2(CHUNK_W, CHUNK_H));
+				{
+					TraceScope scope(trace.get(), "uniforms");
+					frame.Commit();
+				}
+				TraceScope scope(trace.get(), "dispatch");
 				compshdr.use();
-				compshdr.setInt("iteration", (iteration++ / N_CHUNKS));
-				compshdr.setFloat("time", (float)glfwGetTime());
-				compshdr.setVector("chunk", glm::ivec2(chunk_x*CHUNK_W, chunk_y * CHUNK_H));
-				glDispatchCompute((GLuint)(TEX_W / CHUNKS_X), (GLuint)(TEX_H / CHUNKS_Y), 1);
+				profiler.Begin("dispatch", (double)CHUNK_W * CHUNK_H);
+				TILE.Dispatch(CHUNK_W, CHUNK_H);
+				profiler.End();
 			}
 
-			glfwPollEvents();
+			{
+				TraceScope scope(trace.get(), "poll events");
+				glfwPollEvents();
+			}
 			if (glfwGetKey(window, GLFW_KEY_SPACE) || glfwGetKey(window, GLFW_KEY_ESCAPE) || glfwGetKey(window, GLFW_KEY_ENTER)) {
 				glfwSetWindowShouldClose(window, GLFW_TRUE);
 				if (glfwGetKey(window, GLFW_KEY_ENTER)) {
@@ -265,19 +287,37 @@ int main() {
 
 			// Rendering Code
 			{
+				TraceScope scope(trace.get(), "draw");
 				glClear(GL_COLOR_BUFFER_BIT);
 				drawshdr.use();
 				glBindVertexArray(VAO);
+				profiler.Begin("barrier");
 				glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+				profiler.End();
+				profiler.Begin("draw");
 				glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+				profiler.End();
+			}
+			{
+				TraceScope scope(trace.get(), "swap");
+				glfwSwapBuffers(window);
 			}
-			glfwSwapBuffers(window);
+			profiler.Collect();
 
 			if (iteration%N_CHUNKS == 0) {
 
 				// Book keeping 
 				double time = glfwGetTime();
-				std::cout << "Number of iterations: " << std::setw(4) << iteration / N_CHUNKS << " FPS: " << std::setw(7) << iteration / (N_CHUNKS * (time - start)) << " Delta: " << std::setw(7) << time - prev << "\t\t\t\r";
+				std::cout << "Number of iterations: " << std::setw(4) << iteration / N_CHUNKS << " FPS: " << std::setw(7) << iteration / (N_CHUNKS * (time - start)) << " Delta: " << std::setw(7) << time - prev;
+				if (trace) trace->Counter("fps", iteration / (N_CHUNKS * (time - start)));
+				if (stats) {
+					TraceScope scope(trace.get(), "readback");
+					std::cout << ' ';
+					RayStats::PrintLine(std::cout, stats->Read());
+					std::cout << std::endl;
+				} else {
+					std::cout << "\t\t\t\r";
+				}
 				prev = time;
 			}
 		}
@@ -286,11 +326,22 @@ int main() {
 		std::cerr << e.what() << std::endl;
 	}
 	std::cout << std::endl;
+	glFinish();
+	profiler.Collect();
+	profiler.Print(std::cout);
 
 	// Cleanup
+	profiler.SetTrace(nullptr);
+	trace.reset();
+	stats.reset();
+	lights.reset();
+	reloader.reset();
+	if (reload_context) {
+		glfwDestroyWindow(reload_context);
+	}
 	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &SSBO_rng);
 	glDeleteBuffers(1, &SSBO_objects);
+	glDeleteBuffers(1, &SSBO_bvh);
 	glDeleteTextures(1, &tex_output);
 	glDeleteVertexArrays(1, &VAO);
 
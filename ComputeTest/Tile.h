@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+
+/*
+ * Workgroup shape of raycompute.comp. The size is baked in at compile time
+ * through TILE_W/TILE_H, so every Tile needs its own program. Dispatches are
+ * rounded up to whole tiles and the shader drops invocations past chunk_size.
+ */
+struct Tile {
+	const char* name;
+	int w;
+	int h;
+
+	// Preamble for Shader<ShaderType::COMPUTE>.
+	std::string Defines() const {
+		return "#define TILE_W " + std::to_string(w) + "\n#define TILE_H " + std::to_string(h) + "\n";
+	}
+
+	GLuint GroupsX(int width) const {
+		return (GLuint)((width + w - 1) / w);
+	}
+
+	GLuint GroupsY(int height) const {
+		return (GLuint)((height + h - 1) / h);
+	}
+
+	// One chunk of `width` x `height` pixels, raycompute.comp must already be bound.
+	void Dispatch(int width, int height) const {
+		glDispatchCompute(GroupsX(width), GroupsY(height), 1);
+	}
+};
+
+// Square tiles keep neighbouring rays coherent, 32x1 matches one warp per scanline run.
+const Tile TILES[] = {
+	{ "8x8", 8, 8 },
+	{ "16x8", 16, 8 },
+	{ "32x1", 32, 1 }
+};
+const int N_TILES = sizeof(TILES) / sizeof(TILES[0]);
+
+// Returns the tile called `name`, or nullptr.
+inline const Tile* FindTile(const std::string& name) {
+	for (const Tile& t : TILES) {
+		if (name == t.name) {
+			return &t;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,96 @@
+#include "TraceRecorder.h"
+
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+	const int PID = 1;
+	const int CPU_TID = 1;
+	const int GPU_TID = 2;
+
+	std::string Escape(const std::string& s) {
+		std::string out;
+		for (char c : s) {
+			if (c == '"' || c == '\\') out += '\\';
+			out += c;
+		}
+		return out;
+	}
+
+	// Names a track of PID; `tid` < 0 names the process itself.
+	std::string Metadata(const char* kind, int tid, const char* name) {
+		std::ostringstream e;
+		e << "{\"name\":\"" << kind << "\",\"ph\":\"M\",\"pid\":" << PID;
+		if (tid >= 0) e << ",\"tid\":" << tid;
+		e << ",\"args\":{\"name\":\"" << Escape(name) << "\"}}";
+		return e.str();
+	}
+}
+
+TraceRecorder::TraceRecorder(const std::string& path) :
+	file(path, std::ios::trunc),
+	origin(Clock::now()),
+	gl_origin(0),
+	first(true) {
+
+	if (!file) {
+		std::cout << "ERR::TRACE::OPEN_FAIL " << path << std::endl;
+		return;
+	}
+	// Queued commands do not delay the timestamp query, so this pairs up with `origin`.
+	glGetInteger64v(GL_TIMESTAMP, &gl_origin);
+
+	file << "[\n";
+	Event(Metadata("process_name", -1, "TracerGL"));
+	Event(Metadata("thread_name", CPU_TID, "CPU"));
+	Event(Metadata("thread_name", GPU_TID, "GPU"));
+}
+
+TraceRecorder::~TraceRecorder() {
+	if (file.is_open()) {
+		file << "\n]\n";
+	}
+}
+
+double TraceRecorder::Now() const {
+	return std::chrono::duration<double, std::micro>(Clock::now() - origin).count();
+}
+
+void TraceRecorder::Event(const std::string& json) {
+	if (!file.is_open()) return;
+	file << (first ? "" : ",\n") << json;
+	first = false;
+}
+
+void TraceRecorder::Begin(const char* name) {
+	std::ostringstream e;
+	e.precision(3);
+	e << std::fixed << "{\"name\":\"" << Escape(name) << "\",\"ph\":\"B\",\"pid\":" << PID << ",\"tid\":" << CPU_TID << ",\"ts\":" << Now() << '}';
+	Event(e.str());
+}
+
+void TraceRecorder::End(const char* name) {
+	std::ostringstream e;
+	e.precision(3);
+	e << std::fixed << "{\"name\":\"" << Escape(name) << "\",\"ph\":\"E\",\"pid\":" << PID << ",\"tid\":" << CPU_TID << ",\"ts\":" << Now() << '}';
+	Event(e.str());
+}
+
+void TraceRecorder::Gpu(const std::string& name, GLuint64 start_ns, GLuint64 end_ns) {
+	const double start = ((GLint64)start_ns - gl_origin) * 1e-3;
+	const double duration = (end_ns > start_ns) ? (end_ns - start_ns) * 1e-3 : 0.0;
+	std::ostringstream e;
+	e.precision(3);
+	e << std::fixed << "{\"name\":\"" << Escape(name) << "\",\"ph\":\"X\",\"pid\":" << PID << ",\"tid\":" << GPU_TID
+		<< ",\"ts\":" << start << ",\"dur\":" << duration << '}';
+	Event(e.str());
+}
+
+void TraceRecorder::Counter(const char* name, double value) {
+	std::ostringstream e;
+	e.precision(3);
+	e << std::fixed << "{\"name\":\"" << Escape(name) << "\",\"ph\":\"C\",\"pid\":" << PID << ",\"ts\":" << Now()
+		<< ",\"args\":{\"value\":" << value << "}}";
+	Event(e.str());
+}
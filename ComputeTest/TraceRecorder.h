@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include <glad/glad.h>
+
+/*
+ * Frame timeline in the Chrome trace event format, for chrome://tracing or
+ * ui.perfetto.dev. CPU phases are nested Begin/End pairs on one track, GPU passes
+ * (from GpuProfiler, see SetTrace) are placed on a second one by their GL_TIMESTAMP
+ * values, mapped onto the CPU clock once at construction. Events are streamed to
+ * the file as they happen, so a long session costs no memory, and the array is
+ * closed on destruction. Viewers accept a trace cut short by a crash as well.
+ */
+class TraceRecorder
+{
+public:
+	// Needs a current GL context, for the clock mapping.
+	explicit TraceRecorder(const std::string& path);
+	~TraceRecorder();
+
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+	bool IsOpen() const {
+		return file.is_open();
+	}
+
+	// CPU phase, may nest. End takes the name Begin did.
+	void Begin(const char* name);
+	void End(const char* name);
+
+	// GPU pass between two GL_TIMESTAMP query results.
+	void Gpu(const std::string& name, GLuint64 start_ns, GLuint64 end_ns);
+
+	// Value over time on its own track, e.g. samples per second.
+	void Counter(const char* name, double value);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	std::ofstream file;
+	Clock::time_point origin;
+	GLint64 gl_origin;		// GL_TIMESTAMP at `origin`
+	bool first;
+
+	double Now() const;		// microseconds since origin
+	void Event(const std::string& json);
+};
+
+// Begin/End around a scope. Does nothing without a recorder.
+class TraceScope
+{
+public:
+	TraceScope(TraceRecorder* trace, const char* name) : trace(trace), name(name) {
+		if (trace) trace->Begin(name);
+	}
+	~TraceScope() {
+		if (trace) trace->End(name);
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	TraceRecorder* trace;
+	const char* name;
+};
@@ -0,0 +1,76 @@
+#include "TwoLevelBvh.h"
+
+TwoLevelBvh::TwoLevelBvh(std::vector<Shape> scene) {
+	// Node 0 is always the scene root.
+	Append(std::move(scene));
+}
+
+uint32_t TwoLevelBvh::Append(std::vector<Shape> group) {
+	const uint32_t node_base = (uint32_t)nodes.size();
+	const uint32_t shape_base = (uint32_t)shapes.size();
+	std::vector<BvhNode> tree = Bvh::Build(group);
+	if (tree.empty()) {
+		tree.push_back(Bvh::EmptyNode());
+	}
+	for (BvhNode& n : tree) {
+		n.offset += (n.count > 0) ? shape_base : node_base;
+	}
+	nodes.insert(nodes.end(), tree.begin(), tree.end());
+	shapes.insert(shapes.end(), group.begin(), group.end());
+	return node_base;
+}
+
+uint32_t TwoLevelBvh::AddGroup(std::vector<Shape> group) {
+	// A group has no single place in the world to sample it at, see Lights.
+	for (Shape& s : group) {
+		s.light = 0;
+	}
+	Group g;
+	g.root = Append(std::move(group));
+	const BvhNode& root = nodes[g.root];
+	g.bounds = Aabb(glm::vec3(root.bmin[0], root.bmin[1], root.bmin[2]), glm::vec3(root.bmax[0], root.bmax[1], root.bmax[2]));
+	groups.push_back(g);
+	return (uint32_t)groups.size() - 1;
+}
+
+void TwoLevelBvh::AddInstance(uint32_t group, const glm::mat4& object_to_world) {
+	placements.push_back({ group, object_to_world });
+}
+
+void TwoLevelBvh::Build() {
+	std::vector<Aabb> bounds;
+	bounds.reserve(placements.size());
+	for (const Placement& p : placements) {
+		const Aabb& local = groups[p.group].bounds;
+		Aabb world;
+		for (int c = 0; c < 8; c++) {
+			glm::vec3 corner((c & 1) ? local.bmax.x : local.bmin.x, (c & 2) ? local.bmax.y : local.bmin.y, (c & 4) ? local.bmax.z : local.bmin.z);
+			world.Grow(glm::vec3(p.object_to_world * glm::vec4(corner, 1.0f)));
+		}
+		bounds.push_back(world);
+	}
+
+	std::vector<uint32_t> order;
+	top = Bvh::Build(bounds, order);
+
+	instances.clear();
+	instances.reserve(order.size());
+	for (uint32_t i : order) {
+		const Placement& p = placements[i];
+		glm::mat4 inv = glm::inverse(p.object_to_world);
+		BvhInstance inst = {};
+		// glm is column major, the shader wants rows.
+		for (int row = 0; row < 3; row++) {
+			for (int col = 0; col < 4; col++) {
+				inst.world_to_object[row * 4 + col] = inv[col][row];
+			}
+		}
+		inst.root = groups[p.group].root;
+		instances.push_back(inst);
+	}
+}
+
+size_t TwoLevelBvh::Bytes() const {
+	return shapes.size() * sizeof(Shape) + nodes.size() * sizeof(BvhNode)
+		+ top.size() * sizeof(BvhNode) + instances.size() * sizeof(BvhInstance);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+
+/*
+ * Placed copy of a shape group, laid out for std430 (matches Instance in raycompute.comp).
+ * Rays are taken into the group's space by the inverse transform, so only that is stored.
+ */
+struct BvhInstance {
+	float world_to_object[12];	// rows of the inverse affine transform
+	uint32_t root;				// bottom level root in the shared node array
+	uint32_t __padd[3];
+};
+
+/*
+ * Two level acceleration structure. Every group of shapes is stored and built once
+ * (bottom level), each instance is just a transform and a root node, and a top level
+ * BVH over the instances' world bounds ties them together. Memory grows with the
+ * unique geometry plus 64 bytes and about two top level nodes per instance.
+ *
+ * Shapes that are not instanced form the scene tree rooted at node 0 of Nodes(), the
+ * same buffer the single level path uses. Group trees follow it, rebased onto their
+ * place in Shapes() and Nodes(). TopNodes() leaves index Instances().
+ *
+ * Density of volumes inside scaled instances is in the group's own units.
+ */
+class TwoLevelBvh
+{
+private:
+	struct Placement {
+		uint32_t group;
+		glm::mat4 object_to_world;
+	};
+
+	struct Group {
+		uint32_t root;
+		Aabb bounds;
+	};
+
+	std::vector<Shape> shapes;
+	std::vector<BvhNode> nodes;
+	std::vector<Group> groups;
+	std::vector<Placement> placements;
+	std::vector<BvhNode> top;
+	std::vector<BvhInstance> instances;
+
+	// Appends a tree over `group` to nodes/shapes, with its links rebased.
+	uint32_t Append(std::vector<Shape> group);
+
+public:
+	explicit TwoLevelBvh(std::vector<Shape> scene = {});
+
+	// Builds the bottom level over `group`, returns the id to instance it with. Light tags are cleared.
+	uint32_t AddGroup(std::vector<Shape> group);
+
+	void AddInstance(uint32_t group, const glm::mat4& object_to_world);
+
+	// Builds the top level over all instances added so far.
+	void Build();
+
+	const std::vector<Shape>& Shapes() const {
+		return shapes;
+	}
+
+	const std::vector<BvhNode>& Nodes() const {
+		return nodes;
+	}
+
+	const std::vector<BvhNode>& TopNodes() const {
+		return top;
+	}
+
+	const std::vector<BvhInstance>& Instances() const {
+		return instances;
+	}
+
+	size_t Groups() const {
+		return groups.size();
+	}
+
+	// Device memory of all four buffers.
+	size_t Bytes() const;
+};
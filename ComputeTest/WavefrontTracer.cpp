@@ -0,0 +1,221 @@
+#include "WavefrontTracer.h"
+
+#include <iostream>
+#include <string>
+
+namespace {
+
+	// WF_STAGE values in raycompute.comp.
+	enum Stage {
+		GENERATE = 1,
+		EXTEND,
+		SHADE,
+		ACCUMULATE,
+		SORT,
+		SHADOW
+	};
+
+	// WfPath (its WfShadow included), WfRay and WfHit in raycompute.comp.
+	const GLsizeiptr PATH_BYTES = 80;
+	const GLsizeiptr RAY_BYTES = 32;
+	const GLsizeiptr HIT_BYTES = 64;
+	// WfQueue, an indirect dispatch command followed by the count.
+	const GLsizeiptr QUEUE_BYTES = 4 * sizeof(GLuint);
+
+	GLuint Groups(int n) {
+		return (GLuint)((n + WavefrontTracer::GROUP - 1) / WavefrontTracer::GROUP);
+	}
+
+	// A negative material shades all of them from the sorted queue.
+	std::string StageDefines(Stage stage, int material = 0) {
+		std::string defines = "#define WF_GROUP " + std::to_string(WavefrontTracer::GROUP) + "\n#define WF_STAGE " + std::to_string(stage) + "\n";
+		if (stage == SHADE) {
+			defines += (material >= 0) ? "#define WF_MATERIAL " + std::to_string(material) + "\n" : "#define WF_SORTED\n";
+		}
+		return defines;
+	}
+
+	// Empty queue: no groups, but a valid indirect command.
+	void ResetQueues(int first, int n) {
+		const GLuint empty[4] = { 0, 1, 1, 0 };
+		glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_RGBA32UI, first * QUEUE_BYTES, n * QUEUE_BYTES, GL_RGBA_INTEGER, GL_UNSIGNED_INT, empty);
+	}
+}
+
+WavefrontTracer::WavefrontTracer(int max_paths, const std::string& defines) :
+	generate("raycompute.comp", StageDefines(GENERATE) + defines),
+	extend("raycompute.comp", StageDefines(EXTEND) + defines),
+	sort("raycompute.comp", StageDefines(SORT) + defines),
+	shade_sorted("raycompute.comp", StageDefines(SHADE, -1) + defines),
+	shadow("raycompute.comp", StageDefines(SHADOW) + defines),
+	accumulate("raycompute.comp", StageDefines(ACCUMULATE) + defines),
+	capacity(max_paths),
+	sorted(false),
+	profiler(nullptr) {
+
+	for (int m = 0; m < MATERIALS; m++) {
+		shade.emplace_back("raycompute.comp", StageDefines(SHADE, m) + defines);
+	}
+
+	glGenBuffers(1, &paths);
+	glGenBuffers(1, &rays);
+	glGenBuffers(1, &hits);
+	glGenBuffers(1, &queue);
+	glGenBuffers(1, &counts);
+	glGenBuffers(1, &cursors);
+	glGenBuffers(1, &stats);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, paths);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * PATH_BYTES, nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, rays);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * RAY_BYTES, nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, hits);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * HIT_BYTES, nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)capacity * QUEUES * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, counts);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, QUEUES * QUEUE_BYTES, nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, cursors);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, MATERIALS * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_DEPTH * QUEUES * QUEUE_BYTES, nullptr, GL_DYNAMIC_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, counts);
+	ResetQueues(0, QUEUES);
+}
+
+WavefrontTracer::~WavefrontTracer() {
+	glDeleteBuffers(1, &paths);
+	glDeleteBuffers(1, &rays);
+	glDeleteBuffers(1, &hits);
+	glDeleteBuffers(1, &queue);
+	glDeleteBuffers(1, &counts);
+	glDeleteBuffers(1, &cursors);
+	glDeleteBuffers(1, &stats);
+}
+
+void WavefrontTracer::SetShading(Shading shading) {
+	sorted = (shading == Shading::SORTED);
+	extend.use();
+	extend.setBool("wf_sorted", sorted);
+}
+
+void WavefrontTracer::SetProfiler(GpuProfiler* profiler) {
+	this->profiler = profiler;
+}
+
+void WavefrontTracer::Begin(const char* pass, double rays) {
+	if (profiler) profiler->Begin(pass, rays);
+}
+
+void WavefrontTracer::End() {
+	if (profiler) profiler->End();
+}
+
+void WavefrontTracer::Trace(FrameUniforms& frame) {
+	const int n = frame.Block().chunk_size[0] * frame.Block().chunk_size[1];
+	if (n > capacity) {
+		std::cout << "ERR::WAVEFRONT::CHUNK_TOO_LARGE " << n << " > " << capacity << std::endl;
+		return;
+	}
+
+	frame.Commit();
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, paths);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, rays);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, hits);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, queue);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, counts);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, cursors);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counts);
+
+	// Generate fills ray queue 0 with every path of the chunk.
+	const GLuint full[4] = { Groups(n), 1, 1, (GLuint)n };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, counts);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, QUEUE_BYTES, full);
+	generate.use();
+	Begin("generate", n);
+	glDispatchCompute(Groups(n), 1, 1);
+	End();
+
+	for (int depth = 0; depth < MAX_DEPTH; depth++) {
+		const int in = depth % 2;
+		const int out = 1 - in;
+
+		// The other ray queue was last bounce's input and is done with.
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, counts);
+		ResetQueues(out, 1);
+		ResetQueues(RAY_QUEUES, QUEUES - RAY_QUEUES);
+		if (sorted) {
+			const GLuint zero = 0;
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, cursors);
+			glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		}
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+		extend.use();
+		extend.setInt("wf_in", in);
+		// Queue lengths stay on the device, so only generate counts rays.
+		Begin("extend");
+		glDispatchComputeIndirect(in * QUEUE_BYTES);
+		End();
+
+		if (sorted) {
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+			sort.use();
+			Begin("sort");
+			glDispatchComputeIndirect(HIT_QUEUE * QUEUE_BYTES);
+			End();
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			shade_sorted.use();
+			shade_sorted.setInt("wf_out", out);
+			Begin("shade");
+			glDispatchComputeIndirect(HIT_QUEUE * QUEUE_BYTES);
+			End();
+		} else {
+			for (int m = 0; m < MATERIALS; m++) {
+				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+				shade[m].use();
+				shade[m].setInt("wf_out", out);
+				Begin("shade");
+				glDispatchComputeIndirect((RAY_QUEUES + m) * QUEUE_BYTES);
+				End();
+			}
+		}
+
+		// Empty when the program was built without NEE or the scene has no lights.
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+		shadow.use();
+		Begin("shadow");
+		glDispatchComputeIndirect(SHADOW_QUEUE * QUEUE_BYTES);
+		End();
+
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		glBindBuffer(GL_COPY_READ_BUFFER, counts);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, stats);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, depth * QUEUES * QUEUE_BYTES, QUEUES * QUEUE_BYTES);
+	}
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	accumulate.use();
+	Begin("accumulate");
+	glDispatchCompute(Groups(n), 1, 1);
+	End();
+}
+
+std::vector<GLuint> WavefrontTracer::Counts() {
+	std::vector<GLuint> raw(MAX_DEPTH * QUEUES * 4);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_COPY_READ_BUFFER, stats);
+	glGetBufferSubData(GL_COPY_READ_BUFFER, 0, raw.size() * sizeof(GLuint), raw.data());
+
+	std::vector<GLuint> result(MAX_DEPTH * COUNTS);
+	for (int depth = 0; depth < MAX_DEPTH; depth++) {
+		const int in = depth % 2;
+		GLuint* row = &result[depth * COUNTS];
+		row[0] = raw[(depth * QUEUES + in) * 4 + 3];
+		row[1] = raw[(depth * QUEUES + 1 - in) * 4 + 3];
+		for (int m = 0; m < MATERIALS; m++) {
+			row[RAY_QUEUES + m] = raw[(depth * QUEUES + RAY_QUEUES + m) * 4 + 3];
+		}
+	}
+	return result;
+}
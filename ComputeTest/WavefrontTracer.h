@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Shader.h"
+#include "FrameUniforms.h"
+#include "GpuProfiler.h"
+
+/*
+ * Wavefront path tracer over the same scene buffers and output image as the
+ * raycompute.comp megakernel. Instead of one invocation carrying a path through
+ * every bounce, each bounce is split into kernels:
+ *   generate   camera rays for every pixel of the chunk into ray queue 0
+ *   extend     closest hit for every queued ray, hits are binned per material
+ *   shade      one kernel per material over its own queue, survivors go to the other ray queue
+ *   shadow     the light samples shade took at diffuse hits, see NEE in raycompute.comp
+ *   accumulate radiance into the image
+ * Queues live on the device and are filled with atomics, extend and shade are
+ * launched with glDispatchComputeIndirect on their counts, so the host never
+ * reads anything back. Paths are the megakernel's, only the order of work differs.
+ *
+ * With Shading::SORTED extend only counts hits per material, a counting sort
+ * pass groups them in one queue and a single shade kernel runs over all of it,
+ * so each workgroup sees one or two materials instead of the four dispatches.
+ */
+class WavefrontTracer
+{
+private:
+	Shader<ShaderType::COMPUTE> generate;
+	Shader<ShaderType::COMPUTE> extend;
+	std::vector<Shader<ShaderType::COMPUTE>> shade;
+	Shader<ShaderType::COMPUTE> sort;
+	Shader<ShaderType::COMPUTE> shade_sorted;
+	Shader<ShaderType::COMPUTE> shadow;
+	Shader<ShaderType::COMPUTE> accumulate;
+
+	GLuint paths;
+	GLuint rays;
+	GLuint hits;
+	GLuint queue;
+	GLuint counts;
+	GLuint cursors;
+	GLuint stats;
+	int capacity;
+	bool sorted;
+	GpuProfiler* profiler;
+
+	void Begin(const char* pass, double rays = 0.0);
+	void End();
+
+public:
+	enum class Shading {
+		QUEUES,		// one queue and shade kernel per material
+		SORTED		// counting sort by material, one shade kernel
+	};
+
+	static const int GROUP = 64;
+	// Two ray queues, then one per material as binned by WfBin in raycompute.comp,
+	// then the unsorted and sorted hits of Shading::SORTED, then the shadow rays.
+	static const int RAY_QUEUES = 2;
+	static const int MATERIALS = 4;
+	static const int HIT_QUEUE = RAY_QUEUES + MATERIALS;
+	static const int SORTED_QUEUE = HIT_QUEUE + 1;
+	static const int SHADOW_QUEUE = SORTED_QUEUE + 1;
+	static const int QUEUES = SHADOW_QUEUE + 1;
+	// Entries per bounce in Counts().
+	static const int COUNTS = RAY_QUEUES + MATERIALS;
+	// Longest path, raycompute.comp's default MAX_DEPTH, one extend and shade round each.
+	static const int MAX_DEPTH = 25;
+
+	// Room for `max_paths` paths in flight, i.e. the largest chunk in pixels.
+	// `defines` go to every stage, e.g. a RayVariant's with at most MAX_DEPTH bounces.
+	explicit WavefrontTracer(int max_paths, const std::string& defines = "");
+	~WavefrontTracer();
+
+	WavefrontTracer(const WavefrontTracer&) = delete;
+	WavefrontTracer& operator=(const WavefrontTracer&) = delete;
+
+	void SetShading(Shading shading);
+
+	// Times every stage under its own pass, summed over bounces. Null turns it off again.
+	void SetProfiler(GpuProfiler* profiler);
+
+	// One sample per pixel of the frame's chunk, blended into the image like raycompute.comp.
+	// Commits the frame once, every stage reads camera, chunk and iteration from it.
+	void Trace(FrameUniforms& frame);
+
+	// Length of the queues as each bounce of the last Trace finished, COUNTS entries per bounce:
+	// rays extended, rays surviving, then hits per material, i.e. the bin sizes in either mode.
+	// Reads back from the device, so it stalls.
+	std::vector<GLuint> Counts();
+};
@@ -0,0 +1,128 @@
+#include "WorkStealingPool.h"
+
+#include <chrono>
+
+WorkStealingPool::WorkStealingPool(int n_threads) : generation(0), active(0), quit(false) {
+	if (n_threads <= 0) {
+		n_threads = (int)std::thread::hardware_concurrency();
+		if (n_threads <= 0) {
+			n_threads = 1;
+		}
+	}
+	workers = std::vector<Worker>(n_threads);
+	ResetStats();
+	for (int i = 0; i < n_threads; i++) {
+		threads.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		std::lock_guard<std::mutex> guard(control);
+		quit = true;
+	}
+	wake.notify_all();
+	for (std::thread& t : threads) {
+		t.join();
+	}
+}
+
+void WorkStealingPool::Run(int n_tasks, const std::function<void(int, int)>& fn) {
+	if (n_tasks <= 0) {
+		return;
+	}
+
+	// Deal the tasks out in contiguous runs so neighbouring tiles start on the same worker.
+	const int n_workers = Size();
+	for (int w = 0; w < n_workers; w++) {
+		std::lock_guard<std::mutex> guard(workers[w].lock);
+		int first = (int)((int64_t)n_tasks * w / n_workers);
+		int last = (int)((int64_t)n_tasks * (w + 1) / n_workers);
+		// Owner pops from the back, so push in reverse to keep it walking forward.
+		for (int t = last - 1; t >= first; t--) {
+			workers[w].tasks.push_back(t);
+		}
+	}
+
+	std::unique_lock<std::mutex> guard(control);
+	job = fn;
+	active = n_workers;
+	generation++;
+	wake.notify_all();
+	done.wait(guard, [this] { return active == 0; });
+	job = nullptr;
+}
+
+bool WorkStealingPool::Pop(int index, int& task) {
+	Worker& w = workers[index];
+	std::lock_guard<std::mutex> guard(w.lock);
+	if (w.tasks.empty()) {
+		return false;
+	}
+	task = w.tasks.back();
+	w.tasks.pop_back();
+	return true;
+}
+
+bool WorkStealingPool::Steal(int index, int& task) {
+	const int n_workers = Size();
+	for (int k = 1; k < n_workers; k++) {
+		Worker& victim = workers[(index + k) % n_workers];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::WorkerLoop(int index) {
+	uint64_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> guard(control);
+			wake.wait(guard, [&] { return quit || generation != seen; });
+			if (quit) {
+				return;
+			}
+			seen = generation;
+		}
+
+		WorkerStats& stats = workers[index].stats;
+		auto start = std::chrono::steady_clock::now();
+		int task;
+		while (true) {
+			if (Pop(index, task)) {
+				job(task, index);
+			} else if (Steal(index, task)) {
+				stats.steals++;
+				job(task, index);
+			} else {
+				break;
+			}
+			stats.tasks++;
+		}
+		stats.busy_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> guard(control);
+		if (--active == 0) {
+			done.notify_one();
+		}
+	}
+}
+
+std::vector<WorkStealingPool::WorkerStats> WorkStealingPool::Stats() const {
+	std::vector<WorkerStats> stats;
+	for (const Worker& w : workers) {
+		stats.push_back(w.stats);
+	}
+	return stats;
+}
+
+void WorkStealingPool::ResetStats() {
+	for (Worker& w : workers) {
+		w.stats = { 0, 0, 0.0 };
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Persistent worker threads, each owning a deque of task indices.
+ * A worker pops from the back of its own deque and, once that runs dry,
+ * steals from the front of the others, so uneven tiles balance themselves.
+ */
+class WorkStealingPool
+{
+public:
+	struct WorkerStats {
+		uint64_t tasks;
+		uint64_t steals;
+		double busy_seconds;
+	};
+
+private:
+	struct alignas(64) Worker {
+		std::mutex lock;
+		std::deque<int> tasks;
+		WorkerStats stats;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<Worker> workers;
+	std::function<void(int, int)> job;
+
+	std::mutex control;
+	std::condition_variable wake;
+	std::condition_variable done;
+	uint64_t generation;
+	int active;
+	bool quit;
+
+	void WorkerLoop(int index);
+	bool Pop(int index, int& task);
+	bool Steal(int index, int& task);
+
+public:
+	// threads <= 0 uses every hardware thread.
+	explicit WorkStealingPool(int threads = 0);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	int Size() const {
+		return (int)workers.size();
+	}
+
+	// Calls fn(task, worker) for every task in [0, n_tasks) and blocks until all of them finished.
+	void Run(int n_tasks, const std::function<void(int, int)>& fn);
+
+	// Accumulated since construction or the last ResetStats().
+	std::vector<WorkerStats> Stats() const;
+	void ResetStats();
+};
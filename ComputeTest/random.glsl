@@ -0,0 +1,235 @@
+// Random numbers for raycompute.comp, the per invocation state lives in rng_state.
+
+// Shapes are mapped from a fixed number of dimensions each, without loops, so every
+// path draws in lockstep and the samplers' strata carry over. REJECTION_SAMPLING
+// brings back the old loops, which go round a varying number of times, for
+// TracerSamplingBench to compare against.
+#ifdef REJECTION_SAMPLING
+vec3 RandomInUnitSphere() {
+	vec3 point = vec3(1.0f);
+	uint tries = 0u;
+	do {
+		tries++;
+		point = vec3(2.0f*rng()-1.0f,2.0f*rng()-1.0f,2.0f*rng()-1.0f);
+		// attenuating radius so that the distribution eventually lies inside the sphere. Avoid inf loop.
+	} while (length(point) >= 1.0f);
+	RAY_STAT_ADD(RS_SPHERE_TRIES, tries);
+
+	return point;
+}
+
+vec2 RandomInUnitDisk() {
+	vec2 point = vec2(1.0f);
+	uint tries = 0u;
+	do {
+		tries++;
+		point = vec2(2.0f*rng()-1.0f,2.0f*rng()-1.0f);
+	} while (length(point) >= 1.0f);
+	RAY_STAT_ADD(RS_DISK_TRIES, tries);
+
+	return point;
+}
+
+vec3 RandomOnUnitSphere() {
+	return normalize(RandomInUnitSphere());
+}
+
+// A point on the unit sphere around the tip of n.
+vec3 RandomCosineHemisphere(vec3 n) {
+	return n + RandomOnUnitSphere();
+}
+#else
+// Two dimensions, z and the angle around it.
+vec3 RandomOnUnitSphere() {
+	float z = 1.0f - 2.0f*rng();
+	float phi = 2.0f*PI*rng();
+	float r = sqrt(max(0.0f, 1.0f - z*z));
+	RAY_STAT(RS_SPHERE_TRIES);
+	return vec3(r*cos(phi), r*sin(phi), z);
+}
+
+// Three, the cube root of the last spreads the radius by volume.
+vec3 RandomInUnitSphere() {
+	vec3 dir = RandomOnUnitSphere();
+	return dir * pow(rng(), 1.0f/3.0f);
+}
+
+// Shirley and Chiu's concentric map of the square, which keeps strata compact.
+vec2 RandomInUnitDisk() {
+	vec2 u = vec2(2.0f*rng()-1.0f, 2.0f*rng()-1.0f);
+	RAY_STAT(RS_DISK_TRIES);
+	bool x_major = abs(u.x) > abs(u.y);
+	float r = x_major ? u.x : u.y;
+	// u.y is only 0 here at the center, where r is too.
+	float phi = x_major ? (PI/4.0f)*(u.y/u.x) : (PI/2.0f) - (PI/4.0f)*(u.x/(u.y == 0.0f ? 1.0f : u.y));
+	return r*vec2(cos(phi), sin(phi));
+}
+
+// Malley's method: the disk lifted onto the hemisphere around n, in Duff et al.'s
+// orthonormal basis, which needs no branch on n either.
+vec3 RandomCosineHemisphere(vec3 n) {
+	vec2 d = RandomInUnitDisk();
+	float s = (n.z >= 0.0f) ? 1.0f : -1.0f;
+	float a = -1.0f/(s + n.z);
+	float b = n.x*n.y*a;
+	vec3 t = vec3(1.0f + s*n.x*n.x*a, s*b, -s*n.x);
+	vec3 bt = vec3(b, s + n.y*n.y*a, -n.y);
+	return d.x*t + d.y*bt + sqrt(max(0.0f, 1.0f - dot(d, d)))*n;
+}
+#endif
+
+
+uint wang_hash(uint seed)
+{	
+	seed = (seed ^ 61) ^ (seed >> 16); 
+	seed *= 9;
+    seed = seed ^ (seed >> 4);
+    seed *= 0x27d4eb2d;
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+
+uint HashCombine(uint seed, uint v) {
+	return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+/*
+ * Samplers, picked at compile time by SAMPLER. Every path draws its numbers in the
+ * same order, so the n-th call is the path's n-th dimension, and each number is a
+ * function of (pixel, sample, dimension, seed) alone: nothing is kept per pixel
+ * from one sample to the next.
+ *   SAMPLER_RANDOM      the pcg4d hash of all four, see Jarzynski and Olano 2020,
+ *                       "Hash Functions for GPU Rendering"
+ *   SAMPLER_SOBOL       Owen scrambled Sobol points, see Burley 2020, "Practical Hash-based
+ *                       Owen Scrambling". Dimensions go in groups of four, each group its
+ *                       own shuffle of the sample index, scrambled per pixel and seed.
+ *   SAMPLER_BLUE_NOISE  the R2 rank-1 lattice, one shuffle of the index per pair of
+ *                       dimensions but the same points in every pixel, each pixel shifted
+ *                       by a blue noise mask toroidally offset per dimension. Neighbours
+ *                       then err in different directions and the error looks like blue noise.
+ * rng_state only counts dimensions, which is all a path carries between kernels.
+ */
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_BLUE_NOISE 2
+#ifndef SAMPLER
+#define SAMPLER SAMPLER_RANDOM
+#endif
+
+uint rng_state;		// the next dimension
+uint rng_pixel;
+uint rng_scramble;	// the pixel's seed for Sobol
+
+#if SAMPLER == SAMPLER_BLUE_NOISE
+// Thresholds of BlueNoise::SIZE^2 pixels, see BlueNoise.h.
+layout(r32f, binding=1) readonly uniform image2D blue_noise;
+#endif
+
+// Starts pixel's sample.
+void rngbegin(uint pixel) {
+	rngresume(pixel, 0u);
+}
+
+// Picks up a path rngstate() was taken from, in another kernel.
+void rngresume(uint pixel, uint s) {
+	rng_pixel = pixel;
+#if SAMPLER == SAMPLER_SOBOL
+	rng_scramble = wang_hash(HashCombine(wang_hash(pixel), seed));
+#endif
+	rng_state = s;
+}
+
+uint rngstate() {
+	return rng_state;
+}
+
+//uint rand_lcg()
+//{
+//    // LCG values from Numerical Recipes
+//    rng_state = 1664525 * rng_state + 1013904223;
+//    return rng_state;
+//}
+
+uvec4 pcg4d(uvec4 v)
+{
+	v = v * 1664525u + 1013904223u;
+	v.x += v.y*v.w; v.y += v.z*v.x; v.z += v.x*v.y; v.w += v.y*v.z;
+	v ^= v >> 16u;
+	v.x += v.y*v.w; v.y += v.z*v.x; v.z += v.x*v.y; v.w += v.y*v.z;
+	return v;
+}
+
+// Owen scrambling of the bits of x, as a hash from the top bit down.
+uint NestedUniformScramble(uint x, uint seed) {
+	x = bitfieldReverse(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return bitfieldReverse(x);
+}
+
+// Generator matrices of the first four Sobol dimensions, Joe and Kuo's polynomials.
+const uint SOBOL_DIRECTIONS[128] = uint[](
+	0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+	0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+	0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+	0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+
+	0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+	0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+	0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+	0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+
+	0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+	0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+	0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+	0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+
+	0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+	0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+	0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+	0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+);
+
+uint Sobol(uint index, uint dim) {
+	uint x = 0u;
+	for (uint bit = 0u; index != 0u; index >>= 1, bit++) {
+		if ((index & 1u) != 0u) {
+			x ^= SOBOL_DIRECTIONS[dim * 32u + bit];
+		}
+	}
+	return x;
+}
+
+// R2 generators, 1/g and 1/g^2 for the plastic number g, as fractions of 2^32.
+const uint R2[2] = uint[](3242174889u, 2447445413u);
+
+// Next dimension of the sample as 32 bits of a fraction.
+uint rand_uint() {
+#if SAMPLER == SAMPLER_SOBOL
+	uint dim = rng_state++;
+	uint seed = wang_hash(HashCombine(rng_scramble, dim / 4u));
+	uint index = NestedUniformScramble(uint(iteration), seed);
+	return NestedUniformScramble(Sobol(index, dim % 4u), HashCombine(seed, dim % 4u));
+#elif SAMPLER == SAMPLER_BLUE_NOISE
+	uint dim = rng_state++;
+	uint index = NestedUniformScramble(uint(iteration), wang_hash(dim / 2u + 1u));
+	// The mask shifted by the dimension's R2 point, so no two nearby dimensions share it.
+	int size = imageSize(blue_noise).x;
+	int width = imageSize(img_output).x;
+	ivec2 at = ivec2(int(rng_pixel) % width, int(rng_pixel) / width);
+	at += ivec2((dim * R2[0]) >> 26, (dim * R2[1]) >> 26);
+	float shift = imageLoad(blue_noise, at % size).r;
+	return index * R2[dim % 2u] + uint(shift * 4294967296.0f);
+#else
+	return pcg4d(uvec4(rng_pixel, uint(iteration), rng_state++, seed)).x;
+#endif
+}
+
+// 24 bits, so it never rounds up to 1.
+float rng() {
+	RAY_STAT(RS_DIMENSIONS);
+	return float(rand_uint() >> 8) * (1.0f/16777216.0f);
+}
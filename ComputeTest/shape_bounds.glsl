@@ -0,0 +1,62 @@
+// Scene object layout and per shape bounds for the BVH build and refit passes.
+
+struct Shape {
+	vec3 A;
+	uint type;
+	vec3 B;
+	uint param;
+	float density;
+};
+
+struct Material {
+	vec3 albedo;
+	float param;
+	vec3 emissive;
+	uint type;
+};
+
+struct InputShape {
+	Shape S;
+	Material M;
+};
+
+const uint SHP_CUBOID = 0x00000002u;
+const uint SHP_RECT	  = 0x00000003u;
+const uint SHP_MESH	  = 0x00000004u;
+const uint SHP_PRIMITIVE_MASK = 0x0000FFFFu;
+const float FLAT_PAD = 1e-4f;
+
+vec3 rotateXZ(vec3 a, float angle) {
+	return vec3(cos(angle)*a.x - sin(angle)*a.z, a.y, sin(angle)*a.x + cos(angle)*a.z);
+}
+
+// Same as Bvh::ShapeBounds on the host.
+void ShapeBounds(Shape s, out vec3 bmin, out vec3 bmax) {
+	uint prim = s.type & SHP_PRIMITIVE_MASK;
+	if (prim == SHP_CUBOID) {
+		float theta = s.param/1000.0f;
+		vec3 center = (s.A + s.B)*0.5f;
+		bmin = vec3(1e30f);
+		bmax = vec3(-1e30f);
+		for (int c = 0; c < 8; c++) {
+			vec3 corner = s.A + vec3(((c & 1) != 0) ? s.B.x : 0.0f, ((c & 2) != 0) ? s.B.y : 0.0f, ((c & 4) != 0) ? s.B.z : 0.0f);
+			vec3 p = center + rotateXZ(corner - center, theta);
+			bmin = min(bmin, p);
+			bmax = max(bmax, p);
+		}
+	} else if (prim == SHP_RECT) {
+		vec3 d = s.B;
+		d[s.param] = 0.0f;
+		bmin = min(s.A, s.A + d);
+		bmax = max(s.A, s.A + d);
+		bmin[s.param] -= FLAT_PAD;
+		bmax[s.param] += FLAT_PAD;
+	} else if (prim == SHP_MESH) {
+		bmin = s.A;
+		bmax = s.B;
+	} else {
+		float r = abs(s.B.x);
+		bmin = s.A - vec3(r);
+		bmax = s.A + vec3(r);
+	}
+}